@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// Harness shared by the benchmark executables. Every result is written as one JSON object per line (JSON Lines), so
+/// runs can be stored and compared to catch regressions:
+///     {"benchmark":"dispatch","params":{"subscribers":100},"operations":2400000,"ns_per_op":83.1,...}
+/// Throughput benchmarks repeat a batch until the minimum time passed and report the time per operation, latency
+/// benchmarks report percentiles of the measured samples.
+
+namespace Benchmark
+{
+    inline uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /// @brief Keeps the compiler from folding the work of the iterations of a benchmark loop into one.
+    inline void ClobberMemory() { std::atomic_signal_fence(std::memory_order_seq_cst); }
+
+    /// --------------------------------------------------------
+    /// Reporting
+    /// --------------------------------------------------------
+
+    /// @brief Formats a parameter of a result as a JSON member.
+    template<typename V>
+    std::string Param(const char* key, const V& value)
+    {
+        std::ostringstream out;
+        out << '"' << key << "\":";
+
+        if constexpr (std::is_same_v<V, bool>)
+        {
+            out << (value ? "true" : "false");
+        }
+        else if constexpr (std::is_arithmetic_v<V>)
+        {
+            out << value;
+        }
+        else
+        {
+            out << '"' << value << '"';
+        }
+
+        return out.str();
+    }
+
+    template<typename... Members>
+    std::string Params(const Members&... members)
+    {
+        std::string params;
+        ((params += (params.empty() ? "" : ",") + members), ...);
+        return params;
+    }
+
+    class Reporter
+    {
+    public:
+        Reporter(std::ostream& out, std::string filter, uint64_t minNanoseconds)
+            : mOut(out), mFilter(std::move(filter)), mMinNanoseconds(minNanoseconds)
+        {
+        }
+
+        bool IsEnabled(const char* name) const { return mFilter.empty() || std::strstr(name, mFilter.c_str()); }
+
+        uint64_t GetMinNanoseconds() const { return mMinNanoseconds; }
+
+        /// @brief Runs a batch once to warm up, then repeatedly until the minimum time passed.
+        /// @param name Name of the benchmark.
+        /// @param params Parameters of the run, from Params().
+        /// @param batch Runs a batch of operations and returns the number of operations.
+        /// @param bytesPerOperation Bytes processed by an operation, to also report GB/s.
+        template<typename Batch>
+        void Throughput(const char* name, const std::string& params, Batch&& batch, uint64_t bytesPerOperation = 0)
+        {
+            if (!IsEnabled(name))
+            {
+                return;
+            }
+
+            batch();
+
+            uint64_t operations = 0;
+            uint64_t elapsed = 0;
+            const uint64_t start = Now();
+
+            do
+            {
+                operations += batch();
+                elapsed = Now() - start;
+            } while (elapsed < mMinNanoseconds);
+
+            const double nanosecondsPerOperation = static_cast<double>(elapsed) / static_cast<double>(operations);
+
+            mOut << "{\"benchmark\":\"" << name << "\",\"params\":{" << params << "},\"operations\":" << operations
+                 << ",\"ns_per_op\":" << nanosecondsPerOperation
+                 << ",\"ops_per_sec\":" << 1e9 / nanosecondsPerOperation;
+
+            if (bytesPerOperation != 0)
+            {
+                mOut << ",\"gb_per_sec\":" << static_cast<double>(bytesPerOperation) / nanosecondsPerOperation;
+            }
+
+            mOut << "}\n";
+            mOut.flush();
+        }
+
+        /// @brief Writes the percentiles of latency samples, the samples are sorted in place.
+        void Latency(const char* name, const std::string& params, std::vector<uint64_t>& samples)
+        {
+            if (samples.empty())
+            {
+                return;
+            }
+
+            std::sort(samples.begin(), samples.end());
+
+            uint64_t sum = 0;
+            for (uint64_t sample : samples) { sum += sample; }
+
+            const auto percentile = [&](double p) {
+                return samples[std::min(samples.size() - 1, static_cast<size_t>(p / 100.0 * samples.size()))];
+            };
+
+            mOut << "{\"benchmark\":\"" << name << "\",\"params\":{" << params << "},\"samples\":" << samples.size()
+                 << ",\"min_ns\":" << samples.front() << ",\"p50_ns\":" << percentile(50)
+                 << ",\"p90_ns\":" << percentile(90) << ",\"p99_ns\":" << percentile(99)
+                 << ",\"p999_ns\":" << percentile(99.9) << ",\"max_ns\":" << samples.back()
+                 << ",\"mean_ns\":" << sum / samples.size() << "}\n";
+            mOut.flush();
+        }
+
+        /// @brief Writes a record about the run, so results of different machines and builds can be told apart.
+        void Context()
+        {
+#ifdef NDEBUG
+            constexpr bool optimized = true;
+#else
+            constexpr bool optimized = false;
+#endif
+#ifdef UTILLIB_EVENT_METRICS
+            constexpr bool metrics = true;
+#else
+            constexpr bool metrics = false;
+#endif
+
+            mOut << "{\"benchmark\":\"context\",\"params\":{"
+                 << Params(Param("hardware_threads", std::thread::hardware_concurrency()), Param("ndebug", optimized),
+                           Param("event_metrics", metrics), Param("min_time_ns", mMinNanoseconds))
+                 << "}}\n";
+        }
+
+    private:
+        std::ostream& mOut;
+
+        std::string mFilter;
+
+        uint64_t mMinNanoseconds;
+    };
+
+    /// @brief Keeps the compiler from optimizing away a value computed by a benchmark. The volatile store is the
+    /// point, the sink is never read.
+    template<typename V>
+    void Consume(V value)
+    {
+        [[maybe_unused]] static volatile V sink;
+        sink = value;
+    }
+
+    /// @brief Runs a function on several threads at once and waits for them.
+    template<typename Fn>
+    void RunThreads(uint32_t threadCount, Fn&& fn)
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount);
+
+        for (uint32_t i = 0; i < threadCount; i++) { threads.emplace_back(fn); }
+        for (std::thread& thread : threads) { thread.join(); }
+    }
+
+    /// @brief Parses the command line of a benchmark executable and runs its benchmarks.
+    /// Usage: <executable> [--filter <substring>] [--min-time <milliseconds>] [--output <file> [--append]]
+    /// @param benchmarks Runs the benchmarks with the Reporter it's passed.
+    /// @return The exit code of main().
+    template<typename Benchmarks>
+    int Run(int argc, char** argv, Benchmarks&& benchmarks)
+    {
+        std::string filter;
+        uint64_t minMilliseconds = 200;
+        const char* output = nullptr;
+        bool append = false;
+
+        for (int i = 1; i < argc; i++)
+        {
+            const bool hasValue = i + 1 < argc;
+
+            if (std::strcmp(argv[i], "--filter") == 0 && hasValue)
+            {
+                filter = argv[++i];
+            }
+            else if (std::strcmp(argv[i], "--min-time") == 0 && hasValue)
+            {
+                minMilliseconds = std::strtoull(argv[++i], nullptr, 10);
+            }
+            else if (std::strcmp(argv[i], "--output") == 0 && hasValue)
+            {
+                output = argv[++i];
+            }
+            else if (std::strcmp(argv[i], "--append") == 0)
+            {
+                append = true;
+            }
+            else
+            {
+                std::cerr << "Usage: " << argv[0]
+                          << " [--filter <substring>] [--min-time <milliseconds>] [--output <file> [--append]]\n";
+                return 1;
+            }
+        }
+
+        std::ofstream file;
+
+        if (output)
+        {
+            file.open(output, append ? std::ios::app : std::ios::trunc);
+
+            if (!file)
+            {
+                std::cerr << "Can't open " << output << ".\n";
+                return 1;
+            }
+        }
+
+        Reporter reporter(file.is_open() ? file : std::cout, filter, minMilliseconds * 1000000);
+
+        reporter.Context();
+        benchmarks(reporter);
+
+        return 0;
+    }
+} // namespace Benchmark
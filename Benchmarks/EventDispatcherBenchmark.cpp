@@ -0,0 +1,542 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Benchmark.h"
+#include "EventDispatcher.h"
+#include "ShardedEventQueue.h"
+#include "StaticEventDispatcher.h"
+
+/// Throughput and latency benchmarks of EventDispatcher and the queues around it, see Benchmark.h for the output.
+/// Usage: EventDispatcherBenchmark [--filter <substring>] [--min-time <milliseconds>] [--output <file> [--append]]
+
+namespace
+{
+    using namespace Benchmark;
+
+    enum class BenchEvent : uint32_t
+    {
+        A,
+        B,
+    };
+
+    struct SmallPayload
+    {
+        uint64_t Value;
+
+        uint64_t Timestamp;
+    };
+
+    /// @brief Large enough to be queued through the payload pool.
+    struct LargePayload
+    {
+        uint64_t Value;
+
+        uint64_t Timestamp;
+
+        uint8_t Bytes[496];
+    };
+
+    static_assert(!PoolEventPayload<SmallPayload>::value && PoolEventPayload<LargePayload>::value);
+
+    /// --------------------------------------------------------
+    /// Subscribers
+    /// --------------------------------------------------------
+
+    struct Counter
+    {
+        uint64_t Sum = 0;
+
+        template<typename T>
+        void OnEvent(const T& data)
+        {
+            Sum += data.Value;
+        }
+    };
+
+    /// @brief Subscriber of the events of one entity, returns early for the others unless it's filtered.
+    struct EntitySubscriber
+    {
+        uint64_t Id = 0;
+
+        uint64_t Sum = 0;
+
+        void OnEvent(const SmallPayload& data)
+        {
+            if (data.Value != Id)
+            {
+                return;
+            }
+
+            Sum += data.Value;
+        }
+    };
+
+    uint64_t gStaticSum = 0;
+
+    /// @brief Distinct handlers for the static and the dynamic dispatcher.
+    template<int N>
+    void CountEvent(const SmallPayload& data)
+    {
+        gStaticSum += data.Value + N;
+        ClobberMemory();
+    }
+
+    using StaticBenchDispatcher =
+        StaticEventDispatcher<BenchEvent, SmallPayload,
+                              StaticHandlers<BenchEvent::A, &CountEvent<0>, &CountEvent<1>, &CountEvent<2>,
+                                             &CountEvent<3>>,
+                              StaticHandlers<BenchEvent::B, &CountEvent<4>>>;
+
+    /// --------------------------------------------------------
+    /// Benchmarks
+    /// --------------------------------------------------------
+
+    /// @brief Dispatch() with 0 to 10k subscribers.
+    void BenchmarkDispatch(Reporter& reporter)
+    {
+        using Dispatcher = EventDispatcher<BenchEvent, SmallPayload>;
+
+        for (uint32_t count : {0u, 1u, 10u, 100u, 1000u, 10000u})
+        {
+            Dispatcher dispatcher;
+            std::vector<Counter> counters(count);
+
+            for (Counter& counter : counters)
+            {
+                dispatcher.Subscribe(BenchEvent::A, Dispatcher::EventFn(&counter, &Counter::OnEvent<SmallPayload>));
+            }
+
+            SmallPayload data{1, 0};
+            const uint32_t batchSize = std::max(1u, 10000 / std::max(1u, count));
+
+            reporter.Throughput("dispatch", Params(Param("subscribers", count)), [&] {
+                for (uint32_t i = 0; i < batchSize; i++) { dispatcher.Dispatch(BenchEvent::A, data); }
+                return batchSize;
+            });
+        }
+    }
+
+    /// @brief StaticEventDispatcher against EventDispatcher with the same four handlers.
+    void BenchmarkStaticDispatch(Reporter& reporter)
+    {
+        using Dispatcher = EventDispatcher<BenchEvent, SmallPayload>;
+        constexpr uint32_t BatchSize = 4096;
+
+        // Read at runtime, so the compiler can't resolve the runtime dispatches at compile time.
+        volatile BenchEvent runtimeEvent = BenchEvent::A;
+        SmallPayload data{1, 0};
+
+        reporter.Throughput("static_dispatch", Params(Param("dispatcher", "static"), Param("event", "compile_time")),
+                            [&] {
+                                for (uint32_t i = 0; i < BatchSize; i++)
+                                {
+                                    StaticBenchDispatcher::Dispatch<BenchEvent::A>(data);
+                                }
+                                return BatchSize;
+                            });
+
+        reporter.Throughput("static_dispatch", Params(Param("dispatcher", "static"), Param("event", "runtime")), [&] {
+            for (uint32_t i = 0; i < BatchSize; i++) { StaticBenchDispatcher::Dispatch(runtimeEvent, data); }
+            return BatchSize;
+        });
+
+        Dispatcher dispatcher;
+        dispatcher.Subscribe(BenchEvent::A, &CountEvent<0>);
+        dispatcher.Subscribe(BenchEvent::A, &CountEvent<1>);
+        dispatcher.Subscribe(BenchEvent::A, &CountEvent<2>);
+        dispatcher.Subscribe(BenchEvent::A, &CountEvent<3>);
+        dispatcher.Subscribe(BenchEvent::B, &CountEvent<4>);
+
+        reporter.Throughput("static_dispatch", Params(Param("dispatcher", "dynamic"), Param("event", "runtime")), [&] {
+            for (uint32_t i = 0; i < BatchSize; i++) { dispatcher.Dispatch(runtimeEvent, data); }
+            return BatchSize;
+        });
+    }
+
+    /// @brief Subscribers that only want the events of one entity, returning early for the others or subscribed
+    /// with an EventFilter, for dispatched and queued events.
+    void BenchmarkFilters(Reporter& reporter)
+    {
+        using Dispatcher = EventDispatcher<BenchEvent, SmallPayload>;
+        constexpr uint32_t SubscriberCount = 100;
+        constexpr uint32_t BatchSize = 1024;
+
+        for (bool filtered : {false, true})
+        {
+            Dispatcher dispatcher;
+            std::vector<EntitySubscriber> subscribers(SubscriberCount);
+
+            for (uint32_t i = 0; i < SubscriberCount; i++)
+            {
+                subscribers[i].Id = i;
+                const Dispatcher::EventFn fn(&subscribers[i], &EntitySubscriber::OnEvent);
+
+                if (filtered)
+                {
+                    dispatcher.Subscribe(BenchEvent::A, fn,
+                                         Dispatcher::EventFilter::Equal(&SmallPayload::Value, uint64_t(i)));
+                }
+                else
+                {
+                    dispatcher.Subscribe(BenchEvent::A, fn);
+                }
+            }
+
+            const char* subscriber = filtered ? "filter" : "early_return";
+
+            reporter.Throughput("filtered_dispatch",
+                                Params(Param("subscriber", subscriber), Param("subscribers", SubscriberCount),
+                                       Param("queued", false)),
+                                [&] {
+                                    for (uint32_t i = 0; i < BatchSize; i++)
+                                    {
+                                        SmallPayload data{i % SubscriberCount, 0};
+                                        dispatcher.Dispatch(BenchEvent::A, data);
+                                    }
+                                    return BatchSize;
+                                });
+
+            reporter.Throughput("filtered_dispatch",
+                                Params(Param("subscriber", subscriber), Param("subscribers", SubscriberCount),
+                                       Param("queued", true)),
+                                [&] {
+                                    for (uint32_t i = 0; i < BatchSize; i++)
+                                    {
+                                        dispatcher.QueueEvent(BenchEvent::A, SmallPayload{i % SubscriberCount, 0});
+                                    }
+
+                                    dispatcher.DispatchQueuedEvents();
+                                    return BatchSize;
+                                });
+        }
+    }
+
+    /// @brief QueueEvent() and DispatchQueuedEvents() of a batch of events, with and without double buffering.
+    template<typename T>
+    void BenchmarkQueue(Reporter& reporter, const char* payload)
+    {
+        using Dispatcher = EventDispatcher<BenchEvent, T>;
+        constexpr uint32_t BatchSize = 1024;
+
+        for (bool doubleBuffered : {false, true})
+        {
+            Dispatcher dispatcher;
+            Counter counter;
+
+            if (doubleBuffered)
+            {
+                dispatcher.EnableDoubleBuffering();
+            }
+
+            dispatcher.Subscribe(BenchEvent::A, typename Dispatcher::EventFn(&counter, &Counter::OnEvent<T>));
+
+            T data = {};
+            data.Value = 1;
+
+            reporter.Throughput("queue_dispatch",
+                                Params(Param("payload", payload), Param("bytes", sizeof(T)),
+                                       Param("pooled", PoolEventPayload<T>::value),
+                                       Param("double_buffered", doubleBuffered)),
+                                [&] {
+                                    for (uint32_t i = 0; i < BatchSize; i++)
+                                    {
+                                        dispatcher.QueueEvent(BenchEvent::A, data);
+                                    }
+
+                                    if (doubleBuffered)
+                                    {
+                                        dispatcher.SwapEventQueues();
+                                    }
+
+                                    dispatcher.DispatchQueuedEvents();
+                                    return BatchSize;
+                                });
+        }
+    }
+
+    /// @brief QueueEventAfterFrames() of events due over the next frames, dispatched by one frame each batch.
+    void BenchmarkScheduledEvents(Reporter& reporter)
+    {
+        using Dispatcher = EventDispatcher<BenchEvent, SmallPayload>;
+        constexpr uint32_t BatchSize = 1024;
+
+        for (uint32_t frames : {1u, 64u})
+        {
+            Dispatcher dispatcher;
+            Counter counter;
+
+            dispatcher.Subscribe(BenchEvent::A, Dispatcher::EventFn(&counter, &Counter::OnEvent<SmallPayload>));
+
+            // In the steady state as many events are due every frame as are scheduled.
+            reporter.Throughput("scheduled_events", Params(Param("frames", frames)), [&] {
+                for (uint32_t i = 0; i < BatchSize; i++)
+                {
+                    dispatcher.QueueEventAfterFrames(BenchEvent::A, SmallPayload{1, 0}, 1 + i % frames);
+                }
+
+                dispatcher.DispatchQueuedEvents();
+                return BatchSize;
+            });
+        }
+    }
+
+    /// @brief Subscribe() and Unsubscribe() of one subscriber next to others, with and without concurrent
+    /// subscriptions, which publish a new snapshot on every change.
+    void BenchmarkSubscribeChurn(Reporter& reporter)
+    {
+        using Dispatcher = EventDispatcher<BenchEvent, SmallPayload>;
+        constexpr uint32_t BatchSize = 64;
+
+        for (uint32_t count : {0u, 100u, 10000u})
+        {
+            for (bool concurrent : {false, true})
+            {
+                Dispatcher dispatcher;
+                std::vector<Counter> counters(count + 1);
+
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    dispatcher.Subscribe(BenchEvent::A,
+                                         Dispatcher::EventFn(&counters[i], &Counter::OnEvent<SmallPayload>));
+                }
+
+                if (concurrent)
+                {
+                    dispatcher.EnableConcurrentSubscriptions();
+                }
+
+                const Dispatcher::EventFn churnFn(&counters.back(), &Counter::OnEvent<SmallPayload>);
+
+                reporter.Throughput("subscribe_unsubscribe",
+                                    Params(Param("subscribers", count), Param("concurrent", concurrent)), [&] {
+                                        for (uint32_t i = 0; i < BatchSize; i++)
+                                        {
+                                            dispatcher.Subscribe(BenchEvent::A, churnFn);
+                                            dispatcher.Unsubscribe(BenchEvent::A, churnFn);
+                                        }
+                                        return BatchSize;
+                                    });
+            }
+        }
+    }
+
+    /// @brief Dispatch() with concurrent subscriptions, while another thread subscribes and unsubscribes or not.
+    /// On a single core the writer takes turns with the dispatching thread, compare runs of the same machine.
+    void BenchmarkDispatchWhileSubscribing(Reporter& reporter)
+    {
+        using Dispatcher = EventDispatcher<BenchEvent, SmallPayload>;
+        constexpr uint32_t SubscriberCount = 100;
+        constexpr uint32_t BatchSize = 256;
+
+        for (bool writer : {false, true})
+        {
+            if (!reporter.IsEnabled("dispatch_while_subscribing"))
+            {
+                return;
+            }
+
+            Dispatcher dispatcher;
+            std::vector<Counter> counters(SubscriberCount + 1);
+
+            for (uint32_t i = 0; i < SubscriberCount; i++)
+            {
+                dispatcher.Subscribe(BenchEvent::A, Dispatcher::EventFn(&counters[i], &Counter::OnEvent<SmallPayload>));
+            }
+
+            dispatcher.EnableConcurrentSubscriptions();
+
+            std::atomic<bool> stop = false;
+            std::thread writerThread;
+
+            if (writer)
+            {
+                writerThread = std::thread([&] {
+                    const Dispatcher::EventFn churnFn(&counters.back(), &Counter::OnEvent<SmallPayload>);
+
+                    while (!stop.load(std::memory_order_relaxed))
+                    {
+                        dispatcher.Subscribe(BenchEvent::A, churnFn);
+                        dispatcher.Unsubscribe(BenchEvent::A, churnFn);
+                    }
+                });
+            }
+
+            SmallPayload data{1, 0};
+
+            reporter.Throughput("dispatch_while_subscribing",
+                                Params(Param("subscribers", SubscriberCount), Param("writer", writer)), [&] {
+                                    for (uint32_t i = 0; i < BatchSize; i++)
+                                    {
+                                        dispatcher.Dispatch(BenchEvent::A, data);
+                                    }
+                                    return BatchSize;
+                                });
+
+            stop.store(true);
+
+            if (writerThread.joinable())
+            {
+                writerThread.join();
+            }
+        }
+    }
+
+    /// @brief Several producer threads queueing at once, into one dispatcher serialized by a mutex or into a
+    /// ShardedEventQueue. The time includes starting the threads and dispatching the events.
+    void BenchmarkMultiProducer(Reporter& reporter)
+    {
+        using Dispatcher = EventDispatcher<BenchEvent, SmallPayload>;
+        using ShardedQueue = ShardedEventQueue<BenchEvent, SmallPayload>;
+        constexpr uint32_t EventsPerProducer = 20000;
+
+        for (uint32_t producers : {1u, 2u, 4u, 8u})
+        {
+            const uint32_t batchSize = producers * EventsPerProducer;
+
+            {
+                Dispatcher dispatcher;
+                Counter counter;
+                std::mutex mutex;
+
+                dispatcher.Subscribe(BenchEvent::A, Dispatcher::EventFn(&counter, &Counter::OnEvent<SmallPayload>));
+
+                reporter.Throughput("multi_producer", Params(Param("queue", "mutex"), Param("producers", producers)),
+                                    [&] {
+                                        RunThreads(producers, [&] {
+                                            const SmallPayload data{1, 0};
+
+                                            for (uint32_t i = 0; i < EventsPerProducer; i++)
+                                            {
+                                                const std::lock_guard<std::mutex> lock(mutex);
+                                                dispatcher.QueueEvent(BenchEvent::A, data);
+                                            }
+                                        });
+
+                                        dispatcher.DispatchQueuedEvents();
+                                        return batchSize;
+                                    });
+            }
+
+            for (ShardedQueue::MergeOrder order :
+                 {ShardedQueue::MergeOrder::PerProducer, ShardedQueue::MergeOrder::Timestamp})
+            {
+                Dispatcher dispatcher;
+                Counter counter;
+                ShardedQueue queue(0, order);
+
+                dispatcher.Subscribe(BenchEvent::A, Dispatcher::EventFn(&counter, &Counter::OnEvent<SmallPayload>));
+
+                const char* name = order == ShardedQueue::MergeOrder::Timestamp ? "sharded_timestamp" : "sharded";
+
+                reporter.Throughput("multi_producer", Params(Param("queue", name), Param("producers", producers)),
+                                    [&] {
+                                        RunThreads(producers, [&] {
+                                            const SmallPayload data{1, 0};
+
+                                            for (uint32_t i = 0; i < EventsPerProducer; i++)
+                                            {
+                                                queue.QueueEvent(BenchEvent::A, data);
+                                            }
+                                        });
+
+                                        queue.DispatchQueuedEvents(dispatcher);
+                                        return batchSize;
+                                    });
+            }
+        }
+    }
+
+    /// @brief Latency from QueueEvent() to the subscriber on the dispatch thread, per wait strategy. One event is in
+    /// flight at a time, the producer waits for it to be handled before queueing the next one.
+    void BenchmarkDispatchThreadLatency(Reporter& reporter)
+    {
+        using Dispatcher = EventDispatcher<BenchEvent, SmallPayload>;
+        using WaitStrategy = Dispatcher::WaitStrategy;
+        constexpr size_t MaxSamples = 1 << 20;
+        constexpr size_t MinSamples = 1000;
+
+        struct LatencyRecorder
+        {
+            std::vector<uint64_t> Samples;
+
+            std::atomic<size_t> Handled = 0;
+
+            void OnEvent(const SmallPayload& data)
+            {
+                Samples.push_back(Now() - data.Timestamp);
+                Handled.fetch_add(1, std::memory_order_release);
+            }
+        };
+
+        const std::pair<WaitStrategy, const char*> strategies[] = {
+            {WaitStrategy::Block, "block"},
+            {WaitStrategy::SpinThenBlock, "spin_then_block"},
+            {WaitStrategy::BusyPoll, "busy_poll"},
+        };
+
+        for (const auto& [strategy, strategyName] : strategies)
+        {
+            if (!reporter.IsEnabled("dispatch_thread_latency"))
+            {
+                return;
+            }
+
+            // A busy polling thread only gives up a single core when it's preempted.
+            if (strategy == WaitStrategy::BusyPoll && std::thread::hardware_concurrency() < 2)
+            {
+                std::cerr << "dispatch_thread_latency: busy_poll skipped, it needs two hardware threads.\n";
+                continue;
+            }
+
+            Dispatcher dispatcher;
+            LatencyRecorder recorder;
+            recorder.Samples.reserve(MaxSamples);
+
+            dispatcher.EnableDoubleBuffering();
+            dispatcher.Subscribe(BenchEvent::A, Dispatcher::EventFn(&recorder, &LatencyRecorder::OnEvent));
+            dispatcher.StartDispatchThread(strategy);
+
+            const uint64_t start = Now();
+
+            for (size_t i = 1; i <= MaxSamples; i++)
+            {
+                dispatcher.QueueEvent(BenchEvent::A, SmallPayload{1, Now()});
+
+                while (recorder.Handled.load(std::memory_order_acquire) != i) { std::this_thread::yield(); }
+
+                if (i >= MinSamples && Now() - start >= reporter.GetMinNanoseconds())
+                {
+                    break;
+                }
+            }
+
+            dispatcher.StopDispatchThread();
+
+            reporter.Latency("dispatch_thread_latency", Params(Param("strategy", strategyName)), recorder.Samples);
+        }
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return Benchmark::Run(argc, argv, [](Benchmark::Reporter& reporter) {
+        BenchmarkDispatch(reporter);
+        BenchmarkStaticDispatch(reporter);
+        BenchmarkFilters(reporter);
+        BenchmarkQueue<SmallPayload>(reporter, "small");
+        BenchmarkQueue<LargePayload>(reporter, "large");
+        BenchmarkScheduledEvents(reporter);
+        BenchmarkSubscribeChurn(reporter);
+        BenchmarkDispatchWhileSubscribing(reporter);
+        BenchmarkMultiProducer(reporter);
+        BenchmarkDispatchThreadLatency(reporter);
+    });
+}
@@ -0,0 +1,356 @@
+#include <clocale>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Benchmark.h"
+#include "FlatHashMap.h"
+#include "InternedString.h"
+#include "Strings.h"
+
+/// Benchmarks of NarrowString and the wide strings against their STL counterparts, of the UTF-8 transcoders of
+/// StringEncoding.h against the locale conversions of the C library, and of InternedString lookups and keys. See
+/// Benchmark.h for the output.
+/// Usage: StringBenchmark [--filter <substring>] [--min-time <milliseconds>] [--output <file> [--append]]
+
+namespace
+{
+    using namespace Benchmark;
+
+    /// @brief Strings per batch, enough to leave the cache for the heap strings.
+    constexpr uint32_t BatchSize = 1024;
+
+    /// @brief Lengths around the inline capacities of the strings.
+    constexpr uint32_t Lengths[] = {4, 8, 23, 64};
+
+    /// @brief Distinct strings of one length, that only differ in their last characters.
+    template<typename U>
+    std::vector<std::basic_string<U>> MakeSources(uint32_t length)
+    {
+        std::vector<std::basic_string<U>> sources(BatchSize, std::basic_string<U>(length, U('a')));
+
+        for (uint32_t i = 0; i < BatchSize; i++)
+        {
+            for (uint32_t c = 0, value = i; c < 4 && c < length; c++, value /= 26)
+            {
+                sources[i][length - 1 - c] = static_cast<U>('a' + value % 26);
+            }
+        }
+
+        return sources;
+    }
+
+    template<typename S, typename U>
+    std::vector<S> MakeStrings(const std::vector<std::basic_string<U>>& sources)
+    {
+        std::vector<S> strings;
+        strings.reserve(sources.size());
+
+        for (const std::basic_string<U>& source : sources) { strings.emplace_back(source.c_str()); }
+
+        return strings;
+    }
+
+    /// @brief Runs the benchmarks of a string type for every length, constructed from its own code units.
+    template<typename S>
+    void BenchmarkString(Reporter& reporter, const char* type)
+    {
+        using Unit = std::remove_cvref_t<decltype(S().c_str()[0])>;
+
+        for (uint32_t length : Lengths)
+        {
+            const std::vector<std::basic_string<Unit>> sources = MakeSources<Unit>(length);
+            const std::string params =
+                Params(Param("type", type), Param("length", length), Param("object_bytes", sizeof(S)));
+
+            reporter.Throughput("string_construct", params, [&] {
+                for (const std::basic_string<Unit>& source : sources)
+                {
+                    const S str(source.c_str());
+                    Consume(str.c_str()[0]);
+                }
+
+                return BatchSize;
+            });
+
+            const std::vector<S> strings = MakeStrings<S>(sources);
+            std::vector<S> copies = strings;
+
+            reporter.Throughput("string_copy", params, [&] {
+                for (uint32_t i = 0; i < BatchSize; i++)
+                {
+                    const S copy(strings[i]);
+                    Consume(copy.c_str()[0]);
+                }
+
+                return BatchSize;
+            });
+
+            reporter.Throughput("string_copy_assign", params, [&] {
+                for (uint32_t i = 0; i < BatchSize; i++) { copies[i] = strings[BatchSize - 1 - i]; }
+
+                ClobberMemory();
+                return BatchSize;
+            });
+
+            reporter.Throughput("string_move", params, [&] {
+                // Rotates the strings by one, every string is moved once.
+                S first(std::move(copies[0]));
+
+                for (uint32_t i = 1; i < BatchSize; i++) { copies[i - 1] = std::move(copies[i]); }
+
+                copies[BatchSize - 1] = std::move(first);
+
+                ClobberMemory();
+                return BatchSize;
+            });
+
+            reporter.Throughput("string_equal", params, [&] {
+                uint32_t equal = 0;
+
+                for (uint32_t i = 0; i < BatchSize; i++) { equal += strings[i] == copies[i]; }
+
+                Consume(equal);
+                return BatchSize;
+            });
+
+            reporter.Throughput("string_hash", params, [&] {
+                size_t hash = 0;
+
+                for (const S& str : strings) { hash ^= std::hash<S>()(str); }
+
+                Consume(hash);
+                return BatchSize;
+            });
+        }
+    }
+
+    /// --------------------------------------------------------
+    /// Transcoding
+    /// --------------------------------------------------------
+
+#if defined(UTILLIB_STRING_AVX2)
+    constexpr const char* SimdName = "avx2";
+#elif defined(UTILLIB_STRING_SSE2)
+    constexpr const char* SimdName = "sse2";
+#else
+    constexpr const char* SimdName = "scalar";
+#endif
+
+    struct Text
+    {
+        const char* Name;
+
+        const char* Sample;
+    };
+
+    /// @brief Samples from one to four byte UTF-8 sequences, repeated to the size of the benchmarked texts.
+    constexpr Text Texts[] = {
+        {"ascii", "The quick brown fox jumps over the lazy dog. "},
+        {"latin", "Größere Häuser wären schön, déjà vu à côté. "},
+        {"cyrillic", "Съешь же ещё этих мягких французских булок. "},
+        {"cjk", "我能吞下玻璃而不伤身体。敏捷的棕色狐狸跳过了懒狗。"},
+        {"emoji", "😀😃😄😁😆😅🤣😂🙂🙃😉😊😇🥰😍🤩"},
+    };
+
+    /// @brief Converts texts of about this many UTF-8 bytes, the GB/s are bytes of the UTF-8 side in both directions.
+    constexpr uint32_t TextSize = 16384;
+
+    void BenchmarkTranscoding(Reporter& reporter)
+    {
+        // The locale conversions need a UTF-8 locale, they aren't benchmarked without one.
+        const bool utf8Locale = std::setlocale(LC_CTYPE, "C.UTF-8") || std::setlocale(LC_CTYPE, "en_US.UTF-8");
+
+        for (const Text& text : Texts)
+        {
+            std::string utf8;
+            while (utf8.size() + std::strlen(text.Sample) <= TextSize) { utf8 += text.Sample; }
+
+            const uint32_t size = static_cast<uint32_t>(utf8.size());
+            const std::string params = Params(Param("text", text.Name), Param("bytes", size), Param("simd", SimdName));
+
+            std::u16string utf16(StringEncoding::LengthFromUtf8<char16_t>(utf8.data(), size), u'\0');
+            std::u32string utf32(StringEncoding::LengthFromUtf8<char32_t>(utf8.data(), size), U'\0');
+            std::wstring wide(StringEncoding::LengthFromUtf8<wchar_t>(utf8.data(), size), L'\0');
+            std::string narrow(size, '\0');
+
+            reporter.Throughput(
+                "utf8_to_utf16", params,
+                [&] {
+                    Consume(StringEncoding::FromUtf8(utf8.data(), size, utf16.data()));
+                    return 1;
+                },
+                size);
+
+            reporter.Throughput(
+                "utf8_to_utf32", params,
+                [&] {
+                    Consume(StringEncoding::FromUtf8(utf8.data(), size, utf32.data()));
+                    return 1;
+                },
+                size);
+
+            reporter.Throughput(
+                "utf16_to_utf8", params,
+                [&] {
+                    Consume(StringEncoding::ToUtf8(utf16.data(), static_cast<uint32_t>(utf16.size()), narrow.data()));
+                    return 1;
+                },
+                size);
+
+            reporter.Throughput(
+                "utf32_to_utf8", params,
+                [&] {
+                    Consume(StringEncoding::ToUtf8(utf32.data(), static_cast<uint32_t>(utf32.size()), narrow.data()));
+                    return 1;
+                },
+                size);
+
+            if (!utf8Locale)
+            {
+                continue;
+            }
+
+            // The conversions the strings used before, for comparison.
+            reporter.Throughput(
+                "locale_mbstowcs", params,
+                [&] {
+                    Consume(std::mbstowcs(wide.data(), utf8.c_str(), wide.size() + 1));
+                    return 1;
+                },
+                size);
+
+            reporter.Throughput(
+                "locale_wcstombs", params,
+                [&] {
+                    Consume(std::wcstombs(narrow.data(), wide.c_str(), narrow.size() + 1));
+                    return 1;
+                },
+                size);
+        }
+    }
+    /// --------------------------------------------------------
+    /// Interning
+    /// --------------------------------------------------------
+
+    constexpr uint32_t ThreadCounts[] = {1, 2, 4};
+
+    /// @brief Interning strings that are interned already, and hash map lookups with interned keys against
+    /// NarrowString keys. The NarrowString lookups use copies of the keys, so the comparisons can't stop at the
+    /// pointers.
+    void BenchmarkInterning(Reporter& reporter)
+    {
+        for (uint32_t length : Lengths)
+        {
+            const std::vector<std::string> sources = MakeSources<char>(length);
+            const std::string params = Params(Param("length", length));
+
+            std::vector<InternedString> interned;
+            interned.reserve(BatchSize);
+
+            for (const std::string& source : sources) { interned.emplace_back(source); }
+
+            reporter.Throughput("intern_lookup", params, [&] {
+                uint32_t ids = 0;
+
+                for (const std::string& source : sources) { ids += InternedString(source).Id(); }
+
+                Consume(ids);
+                return BatchSize;
+            });
+
+            reporter.Throughput("intern_find", params, [&] {
+                uint32_t found = 0;
+                InternedString result;
+
+                for (const std::string& source : sources) { found += InternedString::Find(source, result); }
+
+                Consume(found);
+                return BatchSize;
+            });
+
+            // The time includes starting the threads, every thread looks the batch up several times to hide it.
+            constexpr uint32_t Rounds = 16;
+
+            for (uint32_t threadCount : ThreadCounts)
+            {
+                reporter.Throughput("intern_lookup_concurrent",
+                                    Params(Param("length", length), Param("threads", threadCount)), [&] {
+                                        RunThreads(threadCount, [&] {
+                                            uint32_t ids = 0;
+
+                                            for (uint32_t round = 0; round < Rounds; round++)
+                                            {
+                                                for (const std::string& source : sources)
+                                                {
+                                                    ids += InternedString(source).Id();
+                                                }
+                                            }
+
+                                            Consume(ids);
+                                        });
+
+                                        return threadCount * Rounds * BatchSize;
+                                    });
+            }
+
+            FlatHashMap<InternedString, uint32_t> internedMap;
+            FlatHashMap<NarrowString, uint32_t> stringMap;
+
+            for (uint32_t i = 0; i < BatchSize; i++)
+            {
+                internedMap[interned[i]] = i;
+                stringMap[NarrowString(sources[i])] = i;
+            }
+
+            const std::vector<NarrowString> keys = MakeStrings<NarrowString>(sources);
+
+            reporter.Throughput("map_find", Params(Param("key", "interned_string"), Param("length", length)), [&] {
+                uint32_t sum = 0;
+
+                for (const InternedString& key : interned) { sum += *internedMap.Find(key); }
+
+                Consume(sum);
+                return BatchSize;
+            });
+
+            reporter.Throughput("map_find", Params(Param("key", "narrow_string"), Param("length", length)), [&] {
+                uint32_t sum = 0;
+
+                for (const NarrowString& key : keys) { sum += *stringMap.Find(key); }
+
+                Consume(sum);
+                return BatchSize;
+            });
+
+            reporter.Throughput("interned_equal", params, [&] {
+                uint32_t equal = 0;
+
+                for (uint32_t i = 0; i < BatchSize; i++) { equal += interned[i] == interned[BatchSize - 1 - i]; }
+
+                Consume(equal);
+                return BatchSize;
+            });
+        }
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return Benchmark::Run(argc, argv, [](Benchmark::Reporter& reporter) {
+        BenchmarkString<NarrowString>(reporter, "narrow_string");
+        BenchmarkString<std::string>(reporter, "std_string");
+        BenchmarkString<WideString>(reporter, "wide_string");
+        BenchmarkString<Utf16String>(reporter, "utf16_string");
+        BenchmarkString<Utf32String>(reporter, "utf32_string");
+        BenchmarkString<std::wstring>(reporter, "std_wstring");
+        BenchmarkString<std::u16string>(reporter, "std_u16string");
+        BenchmarkTranscoding(reporter);
+        BenchmarkInterning(reporter);
+    });
+}
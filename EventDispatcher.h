@@ -2,11 +2,71 @@
 
 #include <vector>
 #include <unordered_map>
-#include <queue>
+#include <deque>
 #include <utility>
 #include <type_traits>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <iterator>
+#include <coroutine>
+#include <optional>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <variant>
+#include <bit>
+#include <cstring>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
 
 #include "Function.h"
+#include "EventMetrics.h"
+#include "FlatHashMap.h"
+#include "EventMailbox.h"
+#include "EventRecording.h"
+#include "SharedPointer.h"
+#include "EventPayloadPool.h"
+
+/// @brief Keeps a subscription made with EventDispatcher::SubscribeScoped() alive. When the token is destroyed or
+/// reset the subscriber isn't called anymore and is pruned from the dispatcher. Move it into the object whose member
+/// function subscribed, so the subscription ends with the object.
+class SubscriptionToken
+{
+public:
+    SubscriptionToken() = default;
+
+    SubscriptionToken(const SubscriptionToken&) = delete;
+
+    SubscriptionToken& operator=(const SubscriptionToken&) = delete;
+
+    SubscriptionToken(SubscriptionToken&&) = default;
+
+    SubscriptionToken& operator=(SubscriptionToken&&) = default;
+
+    /// @brief Ends the subscription.
+    void Reset() { mLifetime.reset(); }
+
+    bool IsActive() const { return !(mLifetime == nullptr); }
+
+private:
+    template<typename E, typename T>
+    friend class EventDispatcher;
+
+    explicit SubscriptionToken(SharedPointer<uint8_t> lifetime) : mLifetime(std::move(lifetime)) {}
+
+    /// @brief The subscriber holds a weak reference to it.
+    SharedPointer<uint8_t> mLifetime;
+};
 
 /// @brief EventDispatcher is a class that dispatches events to the appropriate event subscribers.
 /// @tparam E Enum type of the event, so that the event dispatcher can be used to dispatch events.
@@ -17,6 +77,31 @@
 /// and the dispatcher can react to the mutated data directly, since everything is passed by reference. In
 /// non-blocking queued QueueEvent() this is not the case, since the data is copied for later dispatching and then
 /// passed to the subscribers. The dispatcher can't react to the data in this case.
+/// Subscribers are called in priority order (highest first), subscribers with equal priority are called in the order
+/// they subscribed. The order is maintained when subscribing, so dispatching is always a linear walk.
+/// Subscribers can also subscribe on a channel (e.g. an entity id), Dispatch() with a channel key then only calls
+/// the subscribers on that channel and the subscribers without a channel.
+/// Events can be given category bits with SetEventCategories(), SubscribeCategory() then subscribes to every event
+/// of the categories (or all events). Wildcard subscribers are resolved into the subscriber lists of the events.
+/// With EnableConcurrentSubscriptions() other threads can subscribe and unsubscribe while dispatching, dispatches read
+/// immutable snapshots of the subscriber lists without locking.
+/// Subscriptions can be tied to the lifetime of a SharedPointer owner or of a SubscriptionToken, they are pruned
+/// automatically once the owner is gone. Lifetime tracking isn't available with concurrent subscriptions.
+/// Events can be scheduled for a point in time or a frame with QueueEventAt() and QueueEventAtFrame(), they are
+/// kept in timer heaps and dispatched in batches by DispatchQueuedEvents() once they are due.
+/// StartDispatchThread() starts a thread that dispatches the double buffered events as soon as they are queued.
+/// Subscribers can be given an EventFilter on a field of the data, the dispatcher then only calls them for the
+/// matching events and evaluates the filters of queued events in batches.
+/// Subscribers that must run on a specific thread subscribe with that thread's EventMailbox, their calls are posted
+/// to the mailbox and run when the thread pumps it.
+/// With EnableDoubleBuffering() queued events are double buffered: QueueEvent() writes to one queue while
+/// DispatchQueuedEvents() drains the other, and SwapEventQueues() is the explicit point where they are exchanged.
+/// Large payloads (see PoolEventPayload) are queued in an EventPayloadPool, the queue then only holds slot indices.
+/// The queue can be bounded with SetQueueCapacity(), per dispatcher or per event type, with an OverflowPolicy that
+/// decides what happens to events queued while it's full.
+/// Coroutines can wait for an event with `co_await dispatcher.Next(eventType)`.
+/// The calls made to the dispatcher can be recorded into an EventRecording and replayed later.
+/// Define UTILLIB_EVENT_METRICS to record dispatch counts, queue latencies and subscriber timings (see EventMetrics.h).
 template<typename E, typename T>
 class EventDispatcher
 {
@@ -27,19 +112,434 @@ public:
     /// @brief Function pointer type to subscribe to an event of type T.
     using EventFn = Function<void(const T&)>;
 
-    /// @brief Map of event subscribers.
-    using SubscriberMap = std::unordered_map<EventEnum_t, std::vector<EventFn>>;
+    /// @brief Priority of a subscriber, subscribers with a higher priority are called first.
+    using Priority_t = int32_t;
+
+    /// @brief Default priority of a subscriber.
+    static constexpr Priority_t DefaultPriority = 0;
+
+    /// @brief Bit mask of event categories, every bit is a category (input, network, ...). Categories can be nested
+    /// by giving a parent category the bits of its children: `Input = Keyboard | Mouse`.
+    using CategoryMask_t = uint64_t;
+
+    /// @brief Mask of a wildcard subscriber that receives every event, including events without a category.
+    static constexpr CategoryMask_t AllCategories = ~CategoryMask_t(0);
+
+    /// @brief Filter of a subscriber on a field of the event data, the subscriber is only called for the events
+    /// whose field equals a value or lies in a range. The dispatcher compares the field itself instead of calling the
+    /// subscriber:
+    ///     dispatcher.Subscribe(Event::Damage, fn, EventFilter::Equal(&DamageData::Target, entityId));
+    class EventFilter
+    {
+    public:
+        /// @brief Filter on a field equal to a value.
+        /// @tparam F Type of the field, an arithmetic or enum type of at most 8 bytes.
+        /// @tparam C Always T, only there so the member pointer isn't formed for a payload that isn't a class.
+        /// @param field The field, e.g. &T::Target.
+        /// @param value The value the field must have.
+        template<typename F, typename C = T>
+        static EventFilter Equal(F C::*field, F value)
+        {
+            return Range(field, value, value);
+        }
+
+        /// @brief Filter on a field in [min, max].
+        /// @tparam F Type of the field, an arithmetic or enum type of at most 8 bytes.
+        /// @param field The field, e.g. &T::Health.
+        /// @param min The lowest value the field can have.
+        /// @param max The highest value the field can have.
+        template<typename F, typename C = T>
+        static EventFilter Range(F C::*field, F min, F max)
+        {
+            static_assert(std::is_same_v<C, T>, "The field must be a member of T.");
+            static_assert(std::is_arithmetic_v<F> || std::is_enum_v<F>,
+                          "Only arithmetic and enum fields can be filtered.");
+            static_assert(sizeof(F) <= sizeof(uint64_t), "The field is too large to be filtered.");
+            assert(!(max < min) && "The range is empty.");
+
+            EventFilter filter;
+            filter.mOffset = FieldOffset(field);
+            filter.mSize = sizeof(F);
+
+            if constexpr (std::is_floating_point_v<F>)
+            {
+                filter.mKind = sizeof(F) == sizeof(float) ? Kind::Float : Kind::Double;
+                filter.mMin = std::bit_cast<uint64_t>(static_cast<double>(min));
+                filter.mMax = std::bit_cast<uint64_t>(static_cast<double>(max));
+            }
+            else
+            {
+                using Integer = typename std::conditional_t<std::is_enum_v<F>, std::underlying_type<F>,
+                                                            std::type_identity<F>>::type;
+
+                // Signed values are sign extended, so one unsigned range check works for both.
+                filter.mKind = std::is_signed_v<Integer> ? Kind::Signed : Kind::Unsigned;
+                filter.mMin = static_cast<uint64_t>(static_cast<Integer>(min));
+                filter.mMax = static_cast<uint64_t>(static_cast<Integer>(max)) - filter.mMin;
+            }
+
+            return filter;
+        }
+
+        /// @brief Checks if it filters, a default constructed filter matches every event.
+        bool IsActive() const { return mKind != Kind::None; }
+
+        bool Matches(const T& data) const
+        {
+            const unsigned char* field = reinterpret_cast<const unsigned char*>(&data) + mOffset;
+
+            if (IsFloatingPoint())
+            {
+                const double value = LoadFloatingPoint(field);
+                return value >= std::bit_cast<double>(mMin) && value <= std::bit_cast<double>(mMax);
+            }
+
+            return LoadInteger(field) - mMin <= mMax;
+        }
+
+    private:
+        friend class EventDispatcher;
+
+        enum class Kind : uint8_t
+        {
+            None,
+            Signed,
+            Unsigned,
+            Float,
+            Double,
+        };
+
+        /// @brief Number of queued events whose filters are evaluated at once, one bit of a match mask each.
+        static constexpr uint32_t BatchSize = 64;
+
+        /// @brief Values of a field in a batch of queued events, shared by the filters on that field.
+        struct Column
+        {
+            /// @brief A filter on the field, only its field is used.
+            EventFilter Field;
+
+            uint64_t Integers[BatchSize];
+
+            double FloatingPoints[BatchSize];
+        };
+
+        /// @brief Offset of a field in T. Only the address of the member is computed, no T is constructed or read.
+        template<typename F, typename C>
+        static uint32_t FieldOffset(F C::*field)
+        {
+            alignas(C) unsigned char storage[sizeof(C)];
+            const C* object = reinterpret_cast<const C*>(storage);
+
+            return static_cast<uint32_t>(reinterpret_cast<const unsigned char*>(&(object->*field)) - storage);
+        }
+
+        template<typename Integer>
+        static uint64_t Load(const unsigned char* field)
+        {
+            Integer value;
+            std::memcpy(&value, field, sizeof(Integer));
+            return static_cast<uint64_t>(value);
+        }
+
+        bool IsFloatingPoint() const { return mKind == Kind::Float || mKind == Kind::Double; }
+
+        uint64_t LoadInteger(const unsigned char* field) const
+        {
+            if (mKind == Kind::Signed)
+            {
+                switch (mSize)
+                {
+                case 1: return Load<int8_t>(field);
+                case 2: return Load<int16_t>(field);
+                case 4: return Load<int32_t>(field);
+                default: return Load<int64_t>(field);
+                }
+            }
+
+            switch (mSize)
+            {
+            case 1: return Load<uint8_t>(field);
+            case 2: return Load<uint16_t>(field);
+            case 4: return Load<uint32_t>(field);
+            default: return Load<uint64_t>(field);
+            }
+        }
+
+        double LoadFloatingPoint(const unsigned char* field) const
+        {
+            if (mKind == Kind::Float)
+            {
+                float value;
+                std::memcpy(&value, field, sizeof(float));
+                return value;
+            }
+
+            double value;
+            std::memcpy(&value, field, sizeof(double));
+            return value;
+        }
+
+        bool HasSameField(const EventFilter& other) const
+        {
+            return mOffset == other.mOffset && mSize == other.mSize && mKind == other.mKind;
+        }
+
+        /// @brief Loads the field of a batch of events into a column.
+        void Gather(const T* const* events, uint32_t count, Column& column) const
+        {
+            column.Field = *this;
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                const unsigned char* field = reinterpret_cast<const unsigned char*>(events[i]) + mOffset;
+
+                if (IsFloatingPoint())
+                {
+                    column.FloatingPoints[i] = LoadFloatingPoint(field);
+                }
+                else
+                {
+                    column.Integers[i] = LoadInteger(field);
+                }
+            }
+        }
+
+        /// @brief Checks the filter on a column, the loops are branchless so the compiler can vectorize them.
+        /// @return Bit i is set if event i matches.
+        uint64_t Match(const Column& column, uint32_t count) const
+        {
+            uint64_t matches = 0;
+
+            if (IsFloatingPoint())
+            {
+                const double min = std::bit_cast<double>(mMin);
+                const double max = std::bit_cast<double>(mMax);
+
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    const double value = column.FloatingPoints[i];
+                    matches |= static_cast<uint64_t>((value >= min) & (value <= max)) << i;
+                }
+            }
+            else
+            {
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    matches |= static_cast<uint64_t>(column.Integers[i] - mMin <= mMax) << i;
+                }
+            }
+
+            return matches;
+        }
+
+        /// @brief Lowest value, for integers zero or sign extended to 64 bits, for floating points a double.
+        uint64_t mMin = 0;
+
+        /// @brief Highest value, for integers the difference to the lowest value so the range check is a single
+        /// unsigned compare.
+        uint64_t mMax = 0;
+
+        uint32_t mOffset = 0;
+
+        uint8_t mSize = 0;
+
+        Kind mKind = Kind::None;
+    };
+
+    /// @brief A subscribed function and its priority.
+    struct Subscriber
+    {
+        /// @brief The other members are set after construction by the subscriptions that use them.
+        Subscriber(const EventFn& fn, Priority_t priority, EventMailbox* mailbox = nullptr)
+            : Fn(fn), Priority(priority), Mailbox(mailbox)
+        {
+        }
+
+        EventFn Fn;
+
+        Priority_t Priority = DefaultPriority;
+
+        /// @brief Mailbox of the thread the subscriber runs on, or null to run it on the dispatching thread.
+        EventMailbox* Mailbox = nullptr;
+
+        /// @brief Category mask of a wildcard subscriber resolved into this list, 0 for a subscriber of the event.
+        CategoryMask_t Categories = 0;
+
+        /// @brief Lifetime of the subscription, the subscriber is pruned once it expired. Null if it's not tracked.
+        WeakPointer<uint8_t> Lifetime;
+
+        /// @brief Filter on the event data, the subscriber is only called for the events it matches.
+        EventFilter Filter;
+
+#ifdef UTILLIB_EVENT_METRICS
+        uint64_t CallCount = 0;
+
+        uint64_t TotalNanoseconds = 0;
+#endif
+    };
+
+    /// @brief Map of event subscribers, each list is sorted by descending priority.
+    using SubscriberMap = std::unordered_map<EventEnum_t, std::vector<Subscriber>>;
+
+    /// @brief Whether queued payloads are stored in an EventPayloadPool, see PoolEventPayload.
+    static constexpr bool PooledPayloads = PoolEventPayload<T>::value;
+
+    /// @brief What the queue holds for a payload: the payload, or the index of its pool slot.
+    using QueuedPayload_t = std::conditional_t<PooledPayloads, uint32_t, T>;
+
+    /// @brief Queue of events. A deque is used so that references to queued events stay valid when subscribers
+    /// queue new events during DispatchQueuedEvents().
+    using EventQueue = std::deque<std::pair<E, QueuedPayload_t>>;
+
+    /// @brief How a queued event is combined with an event of the same type that is already in the queue.
+    enum class CoalescePolicy : uint8_t
+    {
+        /// @brief Every queued event is dispatched.
+        None,
+
+        /// @brief The new data overwrites the data of the already queued event.
+        LatestWins,
+
+        /// @brief The new data is merged into the already queued event with a MergeFn.
+        Merge,
+
+        /// @brief The new event is dropped if an event with the same key (KeyFn) is already queued.
+        DropDuplicates,
+    };
+
+    /// @brief Merges the new data (second argument) into the already queued data (first argument).
+    using MergeFn = Function<void(T&, const T&)>;
+
+    /// @brief Returns the deduplication key of the data.
+    using KeyFn = Function<uint64_t(const T&)>;
+
+    /// @brief What QueueEvent() does when the queue is at capacity.
+    enum class OverflowPolicy : uint8_t
+    {
+        /// @brief Wait until the consumer drains the queue. Only waits for producers on another thread than the
+        /// consumer, the thread that calls SwapEventQueues(). Without double buffering, and for events queued on
+        /// the consumer thread (by its subscribers for example), the wait would never return: the new event is
+        /// dropped instead and passed to the OverflowFn, if one is set.
+        Block,
+
+        /// @brief Drop the new event.
+        DropNewest,
+
+        /// @brief Drop the oldest queued event to make room for the new one.
+        DropOldest,
+
+        /// @brief Overwrite the newest queued event of the same type with the new data, drop the new event if
+        /// there is none.
+        Coalesce,
+
+        /// @brief Drop the new event and pass it to an OverflowFn.
+        Callback,
+    };
+
+    /// @brief Receives the events rejected by OverflowPolicy::Callback.
+    using OverflowFn = Function<void(E, const T&)>;
+
+    /// @brief Key of a channel, subscribers on a channel only receive the events dispatched to the same key.
+    using ChannelKey_t = uint64_t;
 
-    /// @brief Queue of events.
-    using EventQueue = std::queue<std::pair<E, T>>;
+    /// @brief How the dispatch thread waits for events. The dispatch_thread_latency benchmark of
+    /// Benchmarks/EventDispatcherBenchmark.cpp measures the queue-to-subscriber latency percentiles of each strategy.
+    enum class WaitStrategy : uint8_t
+    {
+        /// @brief Sleep until an event is queued or a scheduled event is due. Lowest CPU use, the wake up costs a
+        /// system call and a context switch (microseconds).
+        Block,
+
+        /// @brief Poll for a while after the last events, then sleep. Bursts of events are picked up without a
+        /// wake up.
+        SpinThenBlock,
+
+        /// @brief Poll all the time, optionally pinned to a core. Lowest latency, occupies a whole core.
+        BusyPoll,
+    };
+
+    EventDispatcher() = default;
+
+    /// @brief Stops the dispatch thread and frees the subscriber snapshots of the concurrent mode, no thread may
+    /// dispatch anymore.
+    ~EventDispatcher()
+    {
+        StopDispatchThread();
+
+        delete mSnapshot.load();
+
+        for (SubscriberSnapshot* snapshot : mRetiredSnapshots) { delete snapshot; }
+        for (SubscriberSnapshot* snapshot : mGraceSnapshots) { delete snapshot; }
+    }
 
     /// @brief Subscribes to an event of type T.
     /// @param eventType The type of the event.
     /// @param eventFn The function pointer to subscribe.
-    void Subscribe(E eventType, const EventFn& eventFn)
+    /// @param priority Priority of the subscriber, higher priorities are called first. Subscribers with the same
+    /// priority are called in the order they subscribed.
+    void Subscribe(E eventType, const EventFn& eventFn, Priority_t priority = DefaultPriority)
+    {
+        const EventEnum_t type = static_cast<EventEnum_t>(eventType);
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+
+        InsertSubscriber(GetSubscribers(type), Subscriber{eventFn, priority});
+        PublishSubscribers(&type);
+    }
+
+    /// @brief Subscribes to an event of type T, the subscriber runs on the thread that owns the mailbox. Dispatching
+    /// posts a copy of the data to the mailbox and returns without waiting, the call runs when the owner thread
+    /// pumps the mailbox. Such a subscriber can't stop the propagation of the event.
+    /// @param eventType The type of the event.
+    /// @param eventFn The function pointer to subscribe.
+    /// @param mailbox The mailbox of the thread to run the subscriber on, must outlive the subscription.
+    /// @param priority Priority of the subscriber, decides the order it is posted in relative to the other
+    /// subscribers.
+    void Subscribe(E eventType, const EventFn& eventFn, EventMailbox& mailbox, Priority_t priority = DefaultPriority)
+    {
+        const EventEnum_t type = static_cast<EventEnum_t>(eventType);
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+
+        InsertSubscriber(GetSubscribers(type), Subscriber{eventFn, priority, &mailbox});
+        PublishSubscribers(&type);
+    }
+
+    /// @brief Subscribes to an event of type T on a channel, the subscriber is only called by the Dispatch() calls
+    /// with the same channel key, e.g. the id of the entity the subscriber belongs to.
+    /// @param eventType The type of the event.
+    /// @param key The channel key.
+    /// @param eventFn The function pointer to subscribe.
+    /// @param priority Priority of the subscriber, higher priorities are called first.
+    void Subscribe(E eventType, ChannelKey_t key, const EventFn& eventFn, Priority_t priority = DefaultPriority)
+    {
+        const ChannelId channel{static_cast<EventEnum_t>(eventType), key};
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+
+        InsertSubscriber(mChannelSubscribers[channel], Subscriber{eventFn, priority});
+        PublishChannel(channel);
+    }
+
+    /// @brief Subscribes to an event of type T with a filter on its data, the subscriber is only called for the
+    /// events the filter matches. Use it for subscribers that would return early for most events: the dispatcher
+    /// compares the field without calling the subscriber. The filters of queued events are evaluated in bulk,
+    /// DispatchQueuedEvents() loads the filtered fields of up to 64 events into columns and checks each filter on
+    /// its column in one loop.
+    /// @param eventType The type of the event.
+    /// @param eventFn The function pointer to subscribe.
+    /// @param filter The filter, see EventFilter::Equal() and EventFilter::Range().
+    /// @param priority Priority of the subscriber, higher priorities are called first.
+    void Subscribe(E eventType, const EventFn& eventFn, const EventFilter& filter,
+                   Priority_t priority = DefaultPriority)
     {
-        auto& subs = mEventSubscribers[static_cast<EventEnum_t>(eventType)];
-        subs.push_back(eventFn);
+        const EventEnum_t type = static_cast<EventEnum_t>(eventType);
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+
+        Subscriber sub{eventFn, priority};
+        sub.Filter = filter;
+
+        mHasFilters.store(true, std::memory_order_relaxed);
+
+        InsertSubscriber(GetSubscribers(type), sub);
+        PublishSubscribers(&type);
     }
 
     /// @brief Unsubscribes from an event of type T. This is a linear search, so it's not very efficient on large
@@ -49,51 +549,2405 @@ public:
     /// @param eventFn The function pointer to unsubscribe.
     void Unsubscribe(E eventType, const EventFn& eventFn)
     {
-        auto& subs = mEventSubscribers[static_cast<EventEnum_t>(eventType)];
-        for (uint32_t i = 0; i < subs.size(); i++)
+        const EventEnum_t type = static_cast<EventEnum_t>(eventType);
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+
+        if (EraseSubscriber(GetSubscribers(type), eventFn))
         {
-            if (subs[i] == eventFn)
+            PublishSubscribers(&type);
+        }
+    }
+
+    /// @brief Unsubscribes from an event of type T on a channel. The channel is removed with its last subscriber,
+    /// so channels of short lived keys don't accumulate.
+    /// @param eventType The type of the event.
+    /// @param key The channel key.
+    /// @param eventFn The function pointer to unsubscribe.
+    void Unsubscribe(E eventType, ChannelKey_t key, const EventFn& eventFn)
+    {
+        const ChannelId channel{static_cast<EventEnum_t>(eventType), key};
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+        std::vector<Subscriber>* subs = mChannelSubscribers.Find(channel);
+
+        if (!subs || !EraseSubscriber(*subs, eventFn))
+        {
+            return;
+        }
+
+        if (subs->empty())
+        {
+            mChannelSubscribers.Erase(channel);
+        }
+
+        PublishChannel(channel);
+    }
+
+    /// --------------------------------------------------------
+    /// Categories
+    /// --------------------------------------------------------
+
+    /// @brief Sets the categories of an event, the wildcard subscribers of the event are updated to match.
+    /// @param eventType The type of the event.
+    /// @param categories The category bits of the event.
+    void SetEventCategories(E eventType, CategoryMask_t categories)
+    {
+        const EventEnum_t type = static_cast<EventEnum_t>(eventType);
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+
+        mEventCategories[type] = categories;
+        ResolveWildcards(type, GetSubscribers(type));
+        PublishSubscribers(&type);
+    }
+
+    /// @brief Get the categories of an event.
+    /// @return The category bits, 0 if none were set.
+    CategoryMask_t GetEventCategories(E eventType) const
+    {
+        const auto found = mEventCategories.find(static_cast<EventEnum_t>(eventType));
+        return found != mEventCategories.end() ? found->second : 0;
+    }
+
+    /// @brief Subscribes to every event with a category in the mask, e.g. all input events, or every event with
+    /// AllCategories. The subscriber is inserted into the subscriber list of every matching event by priority, so
+    /// dispatching costs the same as with a Subscribe() per event. Events that get their first subscriber or
+    /// categories later are matched then.
+    /// @param categories The categories to subscribe to, AllCategories for every event.
+    /// @param eventFn The function pointer to subscribe.
+    /// @param priority Priority of the subscriber, higher priorities are called first. Subscribers with the same
+    /// priority subscribed to the event itself are called first.
+    void SubscribeCategory(CategoryMask_t categories, const EventFn& eventFn, Priority_t priority = DefaultPriority)
+    {
+        assert(categories != 0 && "A wildcard subscriber needs at least one category.");
+
+        Subscriber sub{eventFn, priority};
+        sub.Categories = categories;
+
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+
+        mWildcardSubscribers.push_back(sub);
+
+        for (auto& [type, subs] : mEventSubscribers)
+        {
+            if (MatchesCategories(type, categories))
             {
-                subs.erase(subs.begin() + i);
-                break;
+                InsertSubscriber(subs, sub);
             }
         }
+
+        PublishSubscribers(nullptr);
     }
 
-    /// @brief Dispatches the event to all the subscribers of the event. This is a blocking call.
-    /// It Blocks until all the subscribers have finished executing.
-    /// @param eventType The type of the event.
-    /// @param data The data to be passed to the subscribers. The data is mutable if T is not const.
-    void Dispatch(E eventType, T& data)
+    /// @brief Unsubscribes a wildcard subscriber from all the events it was resolved into: O(events * n).
+    /// @param categories The categories it subscribed to.
+    /// @param eventFn The function pointer to unsubscribe.
+    void UnsubscribeCategory(CategoryMask_t categories, const EventFn& eventFn)
     {
-        const auto subscribers = mEventSubscribers.find(static_cast<EventEnum_t>(eventType));
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+
+        if (!EraseSubscriber(mWildcardSubscribers, eventFn, categories))
+        {
+            return;
+        }
 
-        if (subscribers == mEventSubscribers.end())
+        for (auto& [type, subs] : mEventSubscribers)
         {
-            return; // No subscribers for this event.
+            EraseSubscriber(subs, eventFn, categories);
         }
 
-        for (auto& eventFn : subscribers->second) { eventFn(data); }
+        PublishSubscribers(nullptr);
     }
 
-    /// @brief Queue an event to be dispatched later. The queue is processed in DispatchQueuedEvents().
+    /// --------------------------------------------------------
+    /// Lifetime tracking
+    /// --------------------------------------------------------
+
+    /// @brief Subscribes to an event of type T for the lifetime of an object, usually the object whose member
+    /// function subscribes. Once the last SharedPointer to the owner is gone the subscriber isn't called anymore,
+    /// and it's pruned from the subscriber list without an Unsubscribe(). The subscription doesn't keep the owner
+    /// alive. Not available with EnableConcurrentSubscriptions(): the reference counts of SharedPointer aren't
+    /// atomic, and the snapshot writers would copy the weak references while the owner's thread releases it.
     /// @param eventType The type of the event.
-    /// @param data The data to be passed to the subscribers.
-    void QueueEvent(E eventType, const T& data) { mEventQueue.push(std::make_pair(eventType, data)); }
+    /// @param eventFn The function pointer to subscribe.
+    /// @param owner The object the subscription belongs to.
+    /// @param priority Priority of the subscriber, higher priorities are called first.
+    /// @return False if nothing was subscribed, because concurrent subscriptions are enabled.
+    template<typename U>
+    [[nodiscard]] bool Subscribe(E eventType, const EventFn& eventFn, const SharedPointer<U>& owner,
+                                 Priority_t priority = DefaultPriority)
+    {
+        if (mConcurrent)
+        {
+            return false;
+        }
 
-    /// @brief Dispatches all the queued events.
-    void DispatchQueuedEvents()
+        SubscribeTracked(eventType, eventFn, WeakPointer<U>(owner).template cast<uint8_t>(), priority);
+        return true;
+    }
+
+    /// @brief Subscribes to an event of type T on a channel for the lifetime of an object, e.g. an entity
+    /// subscribing on its own id. The subscriber is pruned once the last SharedPointer to the owner is gone, and
+    /// the channel with its last subscriber. Not available with EnableConcurrentSubscriptions().
+    /// @param eventType The type of the event.
+    /// @param key The channel key.
+    /// @param eventFn The function pointer to subscribe.
+    /// @param owner The object the subscription belongs to.
+    /// @param priority Priority of the subscriber, higher priorities are called first.
+    /// @return False if nothing was subscribed, because concurrent subscriptions are enabled.
+    template<typename U>
+    [[nodiscard]] bool Subscribe(E eventType, ChannelKey_t key, const EventFn& eventFn, const SharedPointer<U>& owner,
+                                 Priority_t priority = DefaultPriority)
     {
-        while (!mEventQueue.empty())
+        if (mConcurrent)
         {
-            auto& event = mEventQueue.front();
-            Dispatch(event.first, event.second);
-            mEventQueue.pop();
+            return false;
         }
+
+        const ChannelId channel{static_cast<EventEnum_t>(eventType), key};
+
+        Subscriber sub{eventFn, priority};
+        sub.Lifetime = WeakPointer<U>(owner).template cast<uint8_t>();
+
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+
+        InsertSubscriber(mChannelSubscribers[channel], sub);
+        PublishChannel(channel);
+        return true;
     }
 
-private:
-    SubscriberMap mEventSubscribers;
+    /// @brief Subscribes to an event of type T until the returned token is destroyed or reset. The subscriber
+    /// isn't called anymore after that and is pruned from the subscriber list without an Unsubscribe(). Not
+    /// available with EnableConcurrentSubscriptions().
+    /// @param eventType The type of the event.
+    /// @param eventFn The function pointer to subscribe.
+    /// @param priority Priority of the subscriber, higher priorities are called first.
+    /// @return The token that keeps the subscription alive, an inactive token if nothing was subscribed because
+    /// concurrent subscriptions are enabled.
+    [[nodiscard]] SubscriptionToken SubscribeScoped(E eventType, const EventFn& eventFn,
+                                                    Priority_t priority = DefaultPriority)
+    {
+        if (mConcurrent)
+        {
+            return SubscriptionToken();
+        }
 
-    EventQueue mEventQueue;
+        SharedPointer<uint8_t> lifetime = CreateSharedPointer<uint8_t>();
+
+        SubscribeTracked(eventType, eventFn, WeakPointer<uint8_t>(lifetime), priority);
+        return SubscriptionToken(std::move(lifetime));
+    }
+
+    /// @brief Removes the subscribers whose owner or token is gone from all the subscriber lists. Dispatching skips
+    /// such subscribers and calls this at the start of the next dispatch that isn't made from a subscriber, so
+    /// calling it by hand is only needed to free the lists of events that aren't dispatched anymore.
+    void PruneSubscribers()
+    {
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+
+        mPruneRequested = false;
+
+        for (auto& [type, subs] : mEventSubscribers) { std::erase_if(subs, IsExpired); }
+
+        // Collect the empty channels first, erasing from the map while iterating it would skip elements.
+        std::vector<ChannelId> emptyChannels;
+
+        mChannelSubscribers.ForEach([&](const ChannelId& channel, std::vector<Subscriber>& subs) {
+            if (std::erase_if(subs, IsExpired) != 0 && subs.empty())
+            {
+                emptyChannels.push_back(channel);
+            }
+        });
+
+        for (const ChannelId& channel : emptyChannels) { mChannelSubscribers.Erase(channel); }
+
+        PublishSubscribers(nullptr);
+    }
+
+    /// --------------------------------------------------------
+    /// Concurrent subscriptions
+    /// --------------------------------------------------------
+
+    /// @brief Allows subscribing and unsubscribing from any thread while the dispatching thread dispatches. Must be
+    /// called before other threads use the dispatcher.
+    /// Dispatching itself stays on one thread at a time: Dispatch(), DispatchQueuedEvents() and StopPropagation()
+    /// keep the state of the running dispatch (nesting depth, stopped propagation, filter batch, awaiters) in the
+    /// dispatcher, so two threads dispatching at once is a data race. Dispatch from several threads by queueing to
+    /// the dispatching thread instead, e.g. with a ShardedEventQueue.
+    /// The writers (Subscribe(), Unsubscribe(), the category functions) are serialized by a mutex, copy the
+    /// changed subscriber list and publish a new immutable snapshot of the lists with an atomic store, the lists
+    /// that didn't change are shared with the previous snapshot. Dispatch() reads the current snapshot without a
+    /// lock, it only increments and decrements a reader counter, and a writer never waits for the readers: the
+    /// replaced snapshots are freed by later writes once no reader can still use them (see
+    /// ReclaimSubscriberSnapshots()). Subscribing from a subscriber takes effect with the next dispatch, without
+    /// concurrent subscriptions it would change the lists that are being walked.
+    /// Subscriptions on a channel are published the same way, in a channel map the snapshots share until a channel
+    /// changes. Per-subscriber metrics are not covered, they must stay on one thread, and subscriptions tied to a
+    /// lifetime aren't available: those Subscribe() overloads return false and SubscribeScoped() an inactive token.
+    void EnableConcurrentSubscriptions()
+    {
+        assert(!HasTrackedSubscribers() && "Lifetime tracked subscribers don't work with concurrent subscriptions.");
+
+        mConcurrent = true;
+        PublishSubscribers(nullptr);
+    }
+
+    /// @brief Frees the replaced subscriber snapshots that no dispatch can still read. Writers call it after every
+    /// publish, call it when subscriptions stop changing for a while to free the last replaced snapshots.
+    void ReclaimSubscriberSnapshots()
+    {
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+        ReclaimSnapshots();
+    }
+
+    /// @brief Dispatches the event to all the subscribers of the event. This is a blocking call.
+    /// It Blocks until all the subscribers have finished executing, or until a subscriber calls StopPropagation().
+    /// Subscribers on a channel aren't called.
+    /// @param eventType The type of the event.
+    /// @param data The data to be passed to the subscribers. The data is mutable if T is not const.
+    void Dispatch(E eventType, T& data)
+    {
+        RecordCall(RecordKind::Dispatch, eventType, 0, &data);
+        PruneIfRequested();
+
+        if (mConcurrent)
+        {
+            const SnapshotReader reader(*this);
+            CallSubscribers(eventType, reader.Find(static_cast<EventEnum_t>(eventType)), nullptr, data);
+            return;
+        }
+
+        CallSubscribers(eventType, FindSubscribers(static_cast<EventEnum_t>(eventType)), nullptr, data);
+    }
+
+    /// @brief Dispatches the event to the subscribers on a channel and to the subscribers without a channel. The
+    /// channel is found with a single hash lookup, subscribers on other channels aren't touched. Both kinds of
+    /// subscribers are called in priority order, with equal priorities the subscribers without a channel first.
+    /// @param eventType The type of the event.
+    /// @param key The channel key.
+    /// @param data The data to be passed to the subscribers. The data is mutable if T is not const.
+    void Dispatch(E eventType, ChannelKey_t key, T& data)
+    {
+        RecordCall(RecordKind::DispatchChannel, eventType, key, &data);
+        PruneIfRequested();
+
+        const EventEnum_t type = static_cast<EventEnum_t>(eventType);
+
+        if (mConcurrent)
+        {
+            const SnapshotReader reader(*this);
+            CallSubscribers(eventType, reader.Find(type), reader.FindChannel(ChannelId{type, key}), data);
+            return;
+        }
+
+        CallSubscribers(eventType, FindSubscribers(type), mChannelSubscribers.Find(ChannelId{type, key}), data);
+    }
+
+    /// @brief Consumes the event that is currently being dispatched, subscribers with a lower priority than the
+    /// calling subscriber won't receive it. Only has an effect when called from inside a subscriber.
+    void StopPropagation() { mPropagationStopped = true; }
+
+    /// @brief Queue an event to be dispatched later. The queue is processed in DispatchQueuedEvents().
+    /// If the event type has a coalesce policy and a matching event is still queued, the event is combined with it
+    /// in O(1) and keeps the position of the already queued event.
+    /// @param eventType The type of the event.
+    /// @param data The data to be passed to the subscribers.
+    void QueueEvent(E eventType, const T& data)
+    {
+        RecordCall(RecordKind::QueueEvent, eventType, 0, &data);
+
+        if (!mDoubleBuffered)
+        {
+            if (PushEvent(eventType, data) == PushResult::Full)
+            {
+                CountDroppedEvent(eventType); // Nobody else can drain the queue, blocking would never return.
+            }
+
+            return;
+        }
+
+        while (true)
+        {
+            // Announce the write, and back off while the consumer is swapping the queues. Together with the order
+            // of the stores in SwapEventQueues() this guarantees the queues are never swapped during a push.
+            mProducerWriting.store(true);
+
+            while (mSwapping.load())
+            {
+                mProducerWriting.store(false);
+                while (mSwapping.load()) { std::this_thread::yield(); }
+                mProducerWriting.store(true);
+            }
+
+            const PushResult result = PushEvent(eventType, data);
+
+            mProducerWriting.store(false, std::memory_order_release);
+
+            if (result != PushResult::Full)
+            {
+                if (mDispatchThreadRunning.load(std::memory_order_relaxed))
+                {
+                    WakeDispatchThread();
+                }
+
+                return;
+            }
+
+            // OverflowPolicy::Block, wait for the consumer to swap and drain.
+            std::this_thread::yield();
+        }
+    }
+
+    /// @brief Dispatches all the queued events. Events queued by the subscribers while dispatching are dispatched
+    /// as well, unless double buffering is enabled: then only the events that were swapped in by the last
+    /// SwapEventQueues() are dispatched and the new events wait for the next swap.
+    void DispatchQueuedEvents()
+    {
+        RecordCall(RecordKind::DispatchQueuedEvents);
+        PruneIfRequested();
+
+        if (mTimedAwaiterCount != 0)
+        {
+            ExpireAwaiters();
+        }
+
+        if (mCallDepth == 0)
+        {
+            mFrame.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // The dispatches below are made by the dispatcher, not by the caller.
+        mCallDepth++;
+
+        if (mScheduledEventCount.load(std::memory_order_relaxed) != 0)
+        {
+            DispatchDueEvents();
+        }
+
+        if (mDoubleBuffered)
+        {
+            while (!mDrainQueue.empty())
+            {
+                auto& event = mDrainQueue.front();
+
+#ifdef UTILLIB_EVENT_METRICS
+                GetEventMetrics(event.first).QueueLatency.Record(EventMetrics::Now() - mDrainQueueTimes.front());
+                mDrainQueueTimes.pop_front();
+#endif
+
+                PrepareFilterBatch(mDrainQueue);
+                Dispatch(event.first, GetQueuedData(event));
+                mQueuedDispatchCount++;
+                OnEventRemoved(event.first);
+
+                if constexpr (PooledPayloads)
+                {
+                    mPayloadPool.ReleaseLater(event.second); // The pool belongs to the producer.
+                }
+
+                mDrainQueue.pop_front();
+            }
+        }
+        else
+        {
+            while (!mEventQueue.empty())
+            {
+                // Mark the event as dispatched before calling the subscribers, so events queued by the subscribers
+                // aren't coalesced into it.
+                mFirstPendingSequence++;
+
+                auto& event = mEventQueue.front();
+
+#ifdef UTILLIB_EVENT_METRICS
+                GetEventMetrics(event.first).QueueLatency.Record(EventMetrics::Now() - mEventQueueTimes.front());
+                mEventQueueTimes.pop_front();
+#endif
+
+                if (!mDroppedSequences.empty() && RemoveDroppedSequence(mFrontSequence))
+                {
+                    mQueuedDispatchCount++; // Keeps the filter batch aligned with the queue.
+                }
+                else
+                {
+                    PrepareFilterBatch(mEventQueue);
+                    Dispatch(event.first, GetQueuedData(event));
+                    mQueuedDispatchCount++;
+                    OnEventRemoved(event.first);
+                }
+
+                if constexpr (PooledPayloads)
+                {
+                    mPayloadPool.Release(event.second);
+                }
+
+                mEventQueue.pop_front();
+
+                mFrontSequence++;
+            }
+
+            // Every coalesce slot is stale now, drop them so the key maps don't grow.
+            for (auto& [type, rule] : mCoalesceRules) { rule.KeyedSlots.Clear(); }
+        }
+
+        mCallDepth--;
+    }
+
+    /// --------------------------------------------------------
+    /// Double buffering
+    /// --------------------------------------------------------
+
+    /// @brief Enables double buffered queues. Call it before queueing any events. QueueEvent() may then be called
+    /// from another thread than the one that dispatches, without locks. QueueEvent() calls must not overlap
+    /// though: with producers on several threads (subscribers queueing events count as one), serialize them.
+    /// UTILLIB_EVENT_METRICS recording isn't thread safe, only use it with producers on the dispatching thread.
+    void EnableDoubleBuffering()
+    {
+        assert(mEventQueue.empty() && "Enable double buffering before queueing events.");
+        mDoubleBuffered = true;
+    }
+
+    /// @brief Hands the events queued since the last swap to DispatchQueuedEvents(). Only called by the thread that
+    /// dispatches, usually once per frame right before DispatchQueuedEvents(). Waits for an in-flight QueueEvent()
+    /// to finish, which is a single push.
+    void SwapEventQueues()
+    {
+        assert(mDoubleBuffered);
+
+        RecordCall(RecordKind::SwapEventQueues);
+
+        mConsumerThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+
+        mSwapping.store(true);
+        while (mProducerWriting.load()) { std::this_thread::yield(); }
+
+        const size_t swappedCount = mEventQueue.size();
+
+        if (mDrainQueue.empty())
+        {
+            std::swap(mEventQueue, mDrainQueue);
+#ifdef UTILLIB_EVENT_METRICS
+            std::swap(mEventQueueTimes, mDrainQueueTimes);
+#endif
+        }
+        else
+        {
+            // The last drain was skipped, keep the order by appending to the events that are still waiting.
+            std::move(mEventQueue.begin(), mEventQueue.end(), std::back_inserter(mDrainQueue));
+            mEventQueue.clear();
+#ifdef UTILLIB_EVENT_METRICS
+            std::move(mEventQueueTimes.begin(), mEventQueueTimes.end(), std::back_inserter(mDrainQueueTimes));
+            mEventQueueTimes.clear();
+#endif
+        }
+
+        if constexpr (PooledPayloads)
+        {
+            mPayloadPool.Recycle(); // The slots of the dispatched events, the producer can't push meanwhile.
+        }
+
+        // The swapped events can't be coalesced into anymore, the consumer owns them now.
+        mFrontSequence += swappedCount;
+        mFirstPendingSequence = mFrontSequence;
+        for (auto& [type, rule] : mCoalesceRules) { rule.KeyedSlots.Clear(); }
+
+        mSwapping.store(false, std::memory_order_release);
+    }
+
+    /// --------------------------------------------------------
+    /// Scheduled events
+    /// --------------------------------------------------------
+
+    /// @brief Queues an event to be dispatched at a point in time. DispatchQueuedEvents() moves the events that are
+    /// due out of the timer heap in one batch and dispatches them in the order they are due, before the events
+    /// queued with QueueEvent(). Can be called from any thread, also while dispatching. Scheduled events aren't
+    /// coalesced, bounded or recorded.
+    /// @param eventType The type of the event.
+    /// @param data The data to be passed to the subscribers, copied until the event is due.
+    /// @param time The earliest time to dispatch the event at.
+    void QueueEventAt(E eventType, const T& data, std::chrono::steady_clock::time_point time)
+    {
+        const int64_t due = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+
+        ScheduleEvent(mClockTimers, mNextClockDue, eventType, data, static_cast<uint64_t>(std::max<int64_t>(due, 0)));
+    }
+
+    /// @brief Queues an event to be dispatched after a delay, see QueueEventAt().
+    /// @param eventType The type of the event.
+    /// @param data The data to be passed to the subscribers, copied until the event is due.
+    /// @param delay The minimum time until the event is dispatched.
+    void QueueEventAfter(E eventType, const T& data, std::chrono::nanoseconds delay)
+    {
+        ScheduleEvent(mClockTimers, mNextClockDue, eventType, data, DeadlineFromNow(delay));
+    }
+
+    /// @brief Queues an event to be dispatched at a frame, see GetFrame(). The frame events that are due are
+    /// dispatched before the clock events that are due. The dispatch thread only counts a frame when it wakes up, use
+    /// clock events with it.
+    /// @param eventType The type of the event.
+    /// @param data The data to be passed to the subscribers, copied until the event is due.
+    /// @param frame The frame to dispatch the event in, or the next one if it already started.
+    void QueueEventAtFrame(E eventType, const T& data, uint64_t frame)
+    {
+        ScheduleEvent(mFrameTimers, mNextFrameDue, eventType, data, frame);
+    }
+
+    /// @brief Queues an event to be dispatched a number of frames later, 1 for the next DispatchQueuedEvents().
+    void QueueEventAfterFrames(E eventType, const T& data, uint64_t frames)
+    {
+        QueueEventAtFrame(eventType, data, GetFrame() + frames);
+    }
+
+    /// @brief Get the current frame, the number of DispatchQueuedEvents() calls made from outside the dispatcher.
+    uint64_t GetFrame() const { return mFrame.load(std::memory_order_relaxed); }
+
+    /// @brief Get the number of scheduled events that weren't dispatched yet.
+    size_t GetScheduledEventCount() const { return mScheduledEventCount.load(std::memory_order_relaxed); }
+
+    /// --------------------------------------------------------
+    /// Dispatch thread
+    /// --------------------------------------------------------
+
+    /// @brief Starts a thread owned by the dispatcher that dispatches the queued events as soon as they are queued,
+    /// instead of waiting for the owner to call DispatchQueuedEvents() once per frame. Double buffering must be
+    /// enabled, the subscribers of queued events then run on the dispatch thread and the owner must not call
+    /// SwapEventQueues(), DispatchQueuedEvents() or Dispatch() itself, the dispatch thread is the dispatching
+    /// thread. Subscribing while it runs needs EnableConcurrentSubscriptions().
+    /// @param strategy How the thread waits for events.
+    /// @param core Core to pin the thread to, -1 to let the OS schedule it. Only supported on Linux.
+    /// @param spinCount Number of polls before SpinThenBlock sleeps.
+    void StartDispatchThread(WaitStrategy strategy = WaitStrategy::Block, int32_t core = -1, uint32_t spinCount = 20000)
+    {
+        assert(mDoubleBuffered && "The dispatch thread needs double buffering.");
+        assert(!mDispatchThread.joinable() && "The dispatch thread is already running.");
+
+        mStopDispatchThread.store(false);
+        mDispatchThreadRunning.store(true);
+        mDispatchThread = std::thread([this, strategy, spinCount] { RunDispatchThread(strategy, spinCount); });
+
+#if defined(__linux__)
+        if (core >= 0)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(core, &cpus);
+            pthread_setaffinity_np(mDispatchThread.native_handle(), sizeof(cpus), &cpus);
+        }
+#else
+        (void)core;
+#endif
+    }
+
+    /// @brief Stops the dispatch thread, after it dispatched the events that are still queued.
+    void StopDispatchThread()
+    {
+        if (!mDispatchThread.joinable())
+        {
+            return;
+        }
+
+        mStopDispatchThread.store(true);
+        WakeDispatchThread();
+
+        mDispatchThread.join();
+        mDispatchThreadRunning.store(false);
+    }
+
+    /// --------------------------------------------------------
+    /// Capacity
+    /// --------------------------------------------------------
+
+    /// @brief Bounds the number of queued events of the dispatcher. Set it before queueing any events.
+    /// @param capacity The maximum number of queued events, 0 for an unbounded queue.
+    /// @param policy What QueueEvent() does when the queue is full.
+    /// @param overflowFn Called with the rejected event by OverflowPolicy::Callback, and by OverflowPolicy::Block
+    /// when it can't wait.
+    void SetQueueCapacity(size_t capacity, OverflowPolicy policy, const OverflowFn& overflowFn = OverflowFn())
+    {
+        assert(mEventQueue.empty() && mDrainQueue.empty() && "Set the capacity before queueing events.");
+
+        mCapacity = CapacityRule{capacity, policy, overflowFn};
+        mBounded = capacity != 0 || !mCapacityRules.empty();
+    }
+
+    /// @brief Bounds the number of queued events of an event type. Set it before queueing any events. Both the
+    /// capacity of the event type and the capacity of the dispatcher apply.
+    /// @param eventType The type of the event.
+    /// @param capacity The maximum number of queued events of this type, 0 for unbounded.
+    /// @param policy What QueueEvent() does when the event type is at capacity.
+    /// @param overflowFn Called with the rejected event by OverflowPolicy::Callback, and by OverflowPolicy::Block
+    /// when it can't wait.
+    void SetQueueCapacity(E eventType, size_t capacity, OverflowPolicy policy,
+                          const OverflowFn& overflowFn = OverflowFn())
+    {
+        assert(mEventQueue.empty() && mDrainQueue.empty() && "Set the capacity before queueing events.");
+
+        if (capacity == 0)
+        {
+            mCapacityRules.erase(static_cast<EventEnum_t>(eventType));
+        }
+        else
+        {
+            CapacityRule& rule = mCapacityRules[static_cast<EventEnum_t>(eventType)];
+            rule.Capacity = capacity;
+            rule.Policy = policy;
+            rule.Overflow = overflowFn;
+        }
+
+        mBounded = mCapacity.Capacity != 0 || !mCapacityRules.empty();
+    }
+
+    /// @brief Get the number of events that were dropped because the queue was full.
+    /// @return The number of dropped events.
+    uint64_t GetDroppedEventCount() const { return mDroppedEventCount.load(std::memory_order_relaxed); }
+
+    /// @brief Get the number of events of a type that were dropped because the queue was full. Not synchronized,
+    /// read it on the thread that queues the events.
+    /// @param eventType The type of the event.
+    /// @return The number of dropped events of this type.
+    uint64_t GetDroppedEventCount(E eventType) const
+    {
+        const auto found = mDroppedEventCounts.find(static_cast<EventEnum_t>(eventType));
+        return found != mDroppedEventCounts.end() ? found->second : 0;
+    }
+
+    /// --------------------------------------------------------
+    /// Coroutines
+    /// --------------------------------------------------------
+
+    /// @brief Base of the awaiters returned by Next(), an intrusive list node so waiting doesn't allocate: the
+    /// awaiter lives in the frame of the waiting coroutine.
+    class AwaiterNode
+    {
+    public:
+        AwaiterNode() = default;
+
+        AwaiterNode(const AwaiterNode&) = delete;
+
+        AwaiterNode& operator=(const AwaiterNode&) = delete;
+
+    protected:
+        friend class EventDispatcher;
+
+        /// @brief Unlinks the node if the coroutine is destroyed while waiting.
+        ~AwaiterNode()
+        {
+            if (Next)
+            {
+                Dispatcher->UnlinkAwaiter(*this);
+            }
+        }
+
+        AwaiterNode* Prev = nullptr;
+
+        AwaiterNode* Next = nullptr;
+
+        EventDispatcher* Dispatcher = nullptr;
+
+        std::coroutine_handle<> Handle;
+
+        /// @brief The data of the event the coroutine was resumed by, null if it timed out.
+        const T* Data = nullptr;
+
+        /// @brief Checks the predicate of the awaiter, null if it has none.
+        bool (*Matches)(const AwaiterNode&, const T&) = nullptr;
+
+        /// @brief Steady clock time in nanoseconds the wait times out at, 0 without a timeout.
+        uint64_t Deadline = 0;
+    };
+
+    /// @brief Awaiter returned by Next(), co_await it to suspend the coroutine until the event is dispatched.
+    /// @tparam Predicate Type of the predicate, or std::nullptr_t.
+    /// @tparam Timed Whether the wait can time out, co_await then returns std::optional<T> instead of T.
+    template<typename Predicate, bool Timed>
+    class EventAwaiter : public AwaiterNode
+    {
+    public:
+        EventAwaiter(EventDispatcher& dispatcher, E eventType, Predicate predicate, uint64_t deadline)
+            : mEventType(eventType), mPredicate(std::move(predicate))
+        {
+            this->Dispatcher = &dispatcher;
+            this->Deadline = deadline;
+
+            if constexpr (!std::is_same_v<Predicate, std::nullptr_t>)
+            {
+                this->Matches = [](const AwaiterNode& node, const T& data) -> bool {
+                    return static_cast<const EventAwaiter&>(node).mPredicate(data);
+                };
+            }
+        }
+
+        bool await_ready() const { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            this->Handle = handle;
+            this->Dispatcher->LinkAwaiter(*this, mEventType);
+        }
+
+        auto await_resume() const
+        {
+            if constexpr (Timed)
+            {
+                return this->Data ? std::optional<T>(*this->Data) : std::optional<T>();
+            }
+            else
+            {
+                return T(*this->Data);
+            }
+        }
+
+    private:
+        E mEventType;
+
+        Predicate mPredicate;
+    };
+
+    /// @brief Waits for the next dispatch of an event: `T data = co_await dispatcher.Next(E::X);`. The coroutine
+    /// is resumed inside Dispatch() (or DispatchQueuedEvents()) after the subscribers, with a copy of the data.
+    /// @param eventType The type of the event.
+    EventAwaiter<std::nullptr_t, false> Next(E eventType) { return {*this, eventType, nullptr, 0}; }
+
+    /// @brief Waits for the next dispatch of an event whose data matches a predicate.
+    /// @param eventType The type of the event.
+    /// @param predicate Callable taking const T& and returning bool, stored in the awaiter.
+    template<typename Predicate>
+        requires std::is_invocable_r_v<bool, Predicate&, const T&>
+    EventAwaiter<Predicate, false> Next(E eventType, Predicate predicate)
+    {
+        return {*this, eventType, std::move(predicate), 0};
+    }
+
+    /// @brief Waits for the next dispatch of an event, or until the timeout expires: co_await returns an empty
+    /// std::optional<T> then. Timeouts are checked by DispatchQueuedEvents(), so they are as precise as its calls.
+    /// @param eventType The type of the event.
+    /// @param timeout The maximum time to wait.
+    EventAwaiter<std::nullptr_t, true> Next(E eventType, std::chrono::nanoseconds timeout)
+    {
+        return {*this, eventType, nullptr, DeadlineFromNow(timeout)};
+    }
+
+    /// @brief Waits for the next dispatch of an event whose data matches a predicate, or until the timeout expires.
+    /// @param eventType The type of the event.
+    /// @param predicate Callable taking const T& and returning bool, stored in the awaiter.
+    /// @param timeout The maximum time to wait.
+    template<typename Predicate>
+    EventAwaiter<Predicate, true> Next(E eventType, Predicate predicate, std::chrono::nanoseconds timeout)
+    {
+        return {*this, eventType, std::move(predicate), DeadlineFromNow(timeout)};
+    }
+
+    /// --------------------------------------------------------
+    /// Recording
+    /// --------------------------------------------------------
+
+    /// @brief Records the calls made to the dispatcher from outside of it into a recording, until StopRecording().
+    /// Replay them with EventRecording::Replay(). Only available if T is trivially copyable. The recording isn't
+    /// synchronized, so record dispatchers whose QueueEvent() calls are on the dispatching thread.
+    /// @param recording The recording to append to, must outlive the recording.
+    void StartRecording(EventRecording<E, T>& recording) { mRecording = &recording; }
+
+    /// @brief Stops recording the calls.
+    void StopRecording() { mRecording = nullptr; }
+
+    /// --------------------------------------------------------
+    /// Coalescing
+    /// --------------------------------------------------------
+
+    /// @brief Sets the coalesce policy of an event type. Use SetMergeFunction() and SetDeduplicationKey() for the
+    /// Merge and DropDuplicates policies.
+    /// @param eventType The type of the event.
+    /// @param policy CoalescePolicy::None or CoalescePolicy::LatestWins.
+    void SetCoalescePolicy(E eventType, CoalescePolicy policy)
+    {
+        assert(policy == CoalescePolicy::None || policy == CoalescePolicy::LatestWins);
+
+        if (policy == CoalescePolicy::None)
+        {
+            mCoalesceRules.erase(static_cast<EventEnum_t>(eventType));
+            return;
+        }
+
+        SetCoalesceRule(eventType, policy).Merge = MergeFn();
+    }
+
+    /// @brief Coalesces queued events of a type by merging the new data into the already queued event.
+    /// @param eventType The type of the event.
+    /// @param mergeFn The function that merges the new data into the queued data.
+    void SetMergeFunction(E eventType, const MergeFn& mergeFn)
+    {
+        SetCoalesceRule(eventType, CoalescePolicy::Merge).Merge = mergeFn;
+    }
+
+    /// @brief Drops queued events of a type if an event with the same key is already queued.
+    /// @param eventType The type of the event.
+    /// @param keyFn The function that returns the key of the data.
+    void SetDeduplicationKey(E eventType, const KeyFn& keyFn)
+    {
+        SetCoalesceRule(eventType, CoalescePolicy::DropDuplicates).Key = keyFn;
+    }
+
+    /// @brief Get the number of events that were coalesced into already queued events instead of being queued.
+    /// @return The number of coalesced events.
+    uint64_t GetCoalescedEventCount() const { return mCoalescedEventCount; }
+
+#ifdef UTILLIB_EVENT_METRICS
+    /// --------------------------------------------------------
+    /// Metrics
+    /// --------------------------------------------------------
+
+    /// @brief Get a snapshot of the recorded metrics.
+    /// @return Metrics of every event type that was dispatched or queued, and of its current subscribers.
+    EventMetrics::Snapshot GetMetrics() const
+    {
+        EventMetrics::Snapshot snapshot;
+        snapshot.QueueHighWaterMark = mQueueHighWaterMark;
+
+        for (const auto& [type, metrics] : mEventMetrics)
+        {
+            EventMetrics::EventTypeMetrics& event = snapshot.Events.emplace_back(metrics);
+            event.EventType = static_cast<int64_t>(type);
+
+            const auto subscribers = mEventSubscribers.find(type);
+
+            if (subscribers == mEventSubscribers.end())
+            {
+                continue;
+            }
+
+            for (uint32_t i = 0; i < subscribers->second.size(); i++)
+            {
+                const Subscriber& sub = subscribers->second[i];
+                event.Subscribers.push_back({i, sub.Priority, sub.CallCount, sub.TotalNanoseconds});
+            }
+        }
+
+        return snapshot;
+    }
+
+    /// @brief Resets all the recorded metrics and trace spans.
+    void ResetMetrics()
+    {
+        mEventMetrics.clear();
+        mTraceSpans.clear();
+        mQueueHighWaterMark = mEventQueue.size() + mDrainQueue.size();
+
+        for (auto& [type, subs] : mEventSubscribers)
+        {
+            for (auto& sub : subs)
+            {
+                sub.CallCount = 0;
+                sub.TotalNanoseconds = 0;
+            }
+        }
+    }
+
+    /// @brief Records a span for every dispatch and subscriber call, until maxSpans spans are recorded.
+    /// @param maxSpans The maximum number of spans to keep, 0 disables tracing.
+    void EnableTracing(size_t maxSpans)
+    {
+        mMaxTraceSpans = maxSpans;
+        mTraceSpans.reserve(maxSpans);
+    }
+
+    /// @brief Writes the recorded spans in the Chrome trace event format.
+    /// @param out The stream to write to.
+    void WriteChromeTrace(std::ostream& out) const { EventMetrics::WriteChromeTrace(out, mTraceSpans); }
+#endif
+
+private:
+    /// @brief An event type and a channel key.
+    struct ChannelId
+    {
+        EventEnum_t Event = {};
+
+        ChannelKey_t Key = 0;
+
+        bool operator==(const ChannelId& other) const { return Event == other.Event && Key == other.Key; }
+    };
+
+    struct ChannelIdHash
+    {
+        size_t operator()(const ChannelId& id) const
+        {
+            return static_cast<size_t>(id.Key ^ (static_cast<uint64_t>(id.Event) * 0xC2B2AE3D27D4EB4Full));
+        }
+    };
+
+    /// @brief Inserts after every subscriber with a higher or equal priority, this keeps the list sorted and stable.
+    static void InsertSubscriber(std::vector<Subscriber>& subs, const Subscriber& sub)
+    {
+        const auto it = std::upper_bound(subs.begin(), subs.end(), sub.Priority,
+                                         [](Priority_t p, const Subscriber& other) { return p > other.Priority; });
+
+        subs.insert(it, sub);
+    }
+
+    /// @brief Erases the first subscriber with the function.
+    /// @param categories Category mask of the wildcard subscriber to erase, 0 to erase a subscriber of the event.
+    /// @return True if a subscriber was erased.
+    static bool EraseSubscriber(std::vector<Subscriber>& subs, const EventFn& eventFn, CategoryMask_t categories = 0)
+    {
+        for (uint32_t i = 0; i < subs.size(); i++)
+        {
+            if (subs[i].Fn == eventFn && subs[i].Categories == categories)
+            {
+                subs.erase(subs.begin() + i);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /// @brief Get the subscriber list of an event, a new list starts with the matching wildcard subscribers.
+    std::vector<Subscriber>& GetSubscribers(EventEnum_t type)
+    {
+        const auto [it, inserted] = mEventSubscribers.try_emplace(type);
+
+        if (inserted && !mWildcardSubscribers.empty())
+        {
+            ResolveWildcards(type, it->second);
+        }
+
+        return it->second;
+    }
+
+    /// @brief Finds the subscriber list of an event to dispatch it. The list is only created when wildcard
+    /// subscribers could match, the first time the event is dispatched.
+    std::vector<Subscriber>* FindSubscribers(EventEnum_t type)
+    {
+        const auto found = mEventSubscribers.find(type);
+
+        if (found != mEventSubscribers.end())
+        {
+            return &found->second;
+        }
+
+        return mWildcardSubscribers.empty() ? nullptr : &GetSubscribers(type);
+    }
+
+    bool MatchesCategories(EventEnum_t type, CategoryMask_t categories) const
+    {
+        if (categories == AllCategories)
+        {
+            return true;
+        }
+
+        const auto found = mEventCategories.find(type);
+        return found != mEventCategories.end() && (found->second & categories) != 0;
+    }
+
+    /// @brief Replaces the wildcard subscribers in the list of an event with the ones matching its categories.
+    void ResolveWildcards(EventEnum_t type, std::vector<Subscriber>& subs)
+    {
+        std::erase_if(subs, [](const Subscriber& sub) { return sub.Categories != 0; });
+
+        for (const Subscriber& sub : mWildcardSubscribers)
+        {
+            if (MatchesCategories(type, sub.Categories))
+            {
+                InsertSubscriber(subs, sub);
+            }
+        }
+    }
+
+    /// @brief Immutable subscriber lists read by Dispatch() in the concurrent mode. Only the subscriber metrics in
+    /// the lists are written after publishing.
+    struct SubscriberSnapshot
+    {
+        using ChannelMap = FlatHashMap<ChannelId, SharedPointer<std::vector<Subscriber>>, ChannelIdHash>;
+
+        FlatHashMap<EventEnum_t, SharedPointer<std::vector<Subscriber>>> Lists;
+
+        /// @brief The AllCategories wildcard subscribers, for the events without a list.
+        SharedPointer<std::vector<Subscriber>> Fallback;
+
+        /// @brief Subscribers on a channel, the map is shared with the previous snapshot unless a channel changed.
+        SharedPointer<ChannelMap> Channels;
+    };
+
+    /// @brief Read section of a dispatch in the concurrent mode, the snapshot can't be freed while it's alive.
+    class SnapshotReader
+    {
+    public:
+        explicit SnapshotReader(EventDispatcher& dispatcher)
+            : mReaders(dispatcher.mSnapshotReaders[dispatcher.mSnapshotEpoch.load() & 1])
+        {
+            // The counter is incremented before the snapshot is loaded, so a writer that sees the counter at zero
+            // after publishing knows this reader will load the new snapshot.
+            mReaders.fetch_add(1);
+            mSnapshot = dispatcher.mSnapshot.load();
+        }
+
+        ~SnapshotReader() { mReaders.fetch_sub(1); }
+
+        std::vector<Subscriber>* Find(EventEnum_t type) const
+        {
+            const SharedPointer<std::vector<Subscriber>>* list = mSnapshot->Lists.Find(type);
+            return (list ? *list : mSnapshot->Fallback).get();
+        }
+
+        std::vector<Subscriber>* FindChannel(const ChannelId& channel) const
+        {
+            const SharedPointer<std::vector<Subscriber>>* list = mSnapshot->Channels->Find(channel);
+            return list ? list->get() : nullptr;
+        }
+
+    private:
+        std::atomic<uint32_t>& mReaders;
+
+        const SubscriberSnapshot* mSnapshot;
+    };
+
+    /// @brief Locks the subscriber lists in the concurrent mode, returns an empty lock otherwise.
+    std::unique_lock<std::mutex> LockSubscribers()
+    {
+        return mConcurrent ? std::unique_lock<std::mutex>(mSubscriberMutex) : std::unique_lock<std::mutex>();
+    }
+
+    /// @brief Publishes a new snapshot in the concurrent mode. Called with the subscriber mutex held.
+    /// @param type The event type whose list changed, or null if any list may have changed.
+    void PublishSubscribers(const EventEnum_t* type)
+    {
+        // Tells the queued dispatches that the filter results of their batch may be stale.
+        mSubscriberVersion.fetch_add(1, std::memory_order_release);
+
+        if (!mConcurrent)
+        {
+            return;
+        }
+
+        SubscriberSnapshot* current = mSnapshot.load(std::memory_order_relaxed);
+        SubscriberSnapshot* snapshot = nullptr;
+
+        if (type && current)
+        {
+            // Only the changed list is copied, the others are shared with the current snapshot.
+            snapshot = new SubscriberSnapshot(*current);
+            snapshot->Lists[*type] = CreateSharedPointer<std::vector<Subscriber>>(mEventSubscribers[*type]);
+        }
+        else
+        {
+            snapshot = new SubscriberSnapshot();
+
+            for (const auto& [listType, subs] : mEventSubscribers)
+            {
+                snapshot->Lists[listType] = CreateSharedPointer<std::vector<Subscriber>>(subs);
+            }
+
+            snapshot->Fallback = CreateSharedPointer<std::vector<Subscriber>>();
+
+            for (const Subscriber& sub : mWildcardSubscribers)
+            {
+                if (sub.Categories == AllCategories)
+                {
+                    InsertSubscriber(*snapshot->Fallback, sub);
+                }
+            }
+
+            snapshot->Channels = CreateSharedPointer<typename SubscriberSnapshot::ChannelMap>();
+
+            mChannelSubscribers.ForEach([&](const ChannelId& channel, std::vector<Subscriber>& subs) {
+                (*snapshot->Channels)[channel] = CreateSharedPointer<std::vector<Subscriber>>(subs);
+            });
+        }
+
+        StoreSnapshot(current, snapshot);
+    }
+
+    /// @brief Publishes a new snapshot in the concurrent mode after the subscribers on a channel changed. Called with
+    /// the subscriber mutex held.
+    void PublishChannel(const ChannelId& channel)
+    {
+        if (!mConcurrent)
+        {
+            return;
+        }
+
+        SubscriberSnapshot* current = mSnapshot.load(std::memory_order_relaxed);
+        SubscriberSnapshot* snapshot = new SubscriberSnapshot(*current);
+
+        // The channel map is copied with the lists of the other channels shared, only the changed list is copied.
+        snapshot->Channels = CreateSharedPointer<typename SubscriberSnapshot::ChannelMap>(*current->Channels);
+
+        if (const std::vector<Subscriber>* subs = mChannelSubscribers.Find(channel))
+        {
+            (*snapshot->Channels)[channel] = CreateSharedPointer<std::vector<Subscriber>>(*subs);
+        }
+        else
+        {
+            snapshot->Channels->Erase(channel);
+        }
+
+        StoreSnapshot(current, snapshot);
+    }
+
+    /// @brief Replaces the current snapshot, the replaced one is freed once no dispatch can still read it.
+    void StoreSnapshot(SubscriberSnapshot* current, SubscriberSnapshot* snapshot)
+    {
+        mSnapshot.store(snapshot);
+
+        if (current)
+        {
+            mRetiredSnapshots.push_back(current);
+        }
+
+        ReclaimSnapshots();
+    }
+
+    /// @brief Frees the retired snapshots once a grace period has passed, without waiting for the readers. A grace
+    /// period starts after the snapshots were replaced and ends when both reader counters have been seen at zero,
+    /// the epoch is flipped before each check so new readers use the other counter and can't keep it from
+    /// draining. Called with the subscriber mutex held.
+    void ReclaimSnapshots()
+    {
+        while (true)
+        {
+            if (mGracePhase == 0)
+            {
+                if (mRetiredSnapshots.empty())
+                {
+                    return;
+                }
+
+                mGraceSnapshots.swap(mRetiredSnapshots);
+                mGraceParity = mSnapshotEpoch.fetch_add(1) & 1;
+                mGracePhase = 1;
+            }
+
+            if (mSnapshotReaders[mGraceParity].load() != 0)
+            {
+                return; // Readers are still in the counter, try again with the next write.
+            }
+
+            if (mGracePhase == 1)
+            {
+                mGraceParity = mSnapshotEpoch.fetch_add(1) & 1;
+                mGracePhase = 2;
+                continue;
+            }
+
+            for (SubscriberSnapshot* snapshot : mGraceSnapshots) { delete snapshot; }
+
+            mGraceSnapshots.clear();
+            mGracePhase = 0;
+        }
+    }
+
+    /// @brief Tells the dispatch thread an event was queued, the system call is only made if it sleeps.
+    void WakeDispatchThread()
+    {
+        // Pairs with the store of mDispatchThreadSleeping in RunDispatchThread(), both are sequentially consistent:
+        // either the thread sees the new signal before sleeping, or this sees that it sleeps and wakes it.
+        mQueuedSignal.fetch_add(1);
+
+        if (mDispatchThreadSleeping.load())
+        {
+            // Empty critical section: the thread holds the mutex from announcing its sleep until it waits.
+            {
+                const std::lock_guard<std::mutex> lock(mDispatchThreadMutex);
+            }
+
+            mDispatchThreadWake.notify_one();
+        }
+    }
+
+    static void CpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_pause();
+#endif
+    }
+
+    void RunDispatchThread(WaitStrategy strategy, uint32_t spinCount)
+    {
+        while (true)
+        {
+            // Read before swapping, an event queued after the swap changes it and isn't missed.
+            const uint32_t signal = mQueuedSignal.load();
+
+            SwapEventQueues();
+            DispatchQueuedEvents();
+
+            if (mStopDispatchThread.load())
+            {
+                SwapEventQueues();
+                DispatchQueuedEvents();
+                return;
+            }
+
+            uint32_t spins = strategy == WaitStrategy::Block ? 0 : spinCount;
+
+            while (mQueuedSignal.load(std::memory_order_acquire) == signal && !IsClockEventDue())
+            {
+                if (strategy == WaitStrategy::BusyPoll || spins != 0)
+                {
+                    spins -= spins != 0;
+                    CpuRelax();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(mDispatchThreadMutex);
+                mDispatchThreadSleeping.store(true);
+
+                // Sleeps until the next scheduled event if there is one. A waker that sees the thread sleeping
+                // takes the mutex before notifying, which it can only get once the thread waits.
+                if (mQueuedSignal.load() == signal)
+                {
+                    const uint64_t nextDue = mNextClockDue.load(std::memory_order_relaxed);
+
+                    if (nextDue == NotDue)
+                    {
+                        mDispatchThreadWake.wait(lock);
+                    }
+                    else
+                    {
+                        mDispatchThreadWake.wait_until(lock, std::chrono::steady_clock::time_point(
+                                                                 std::chrono::nanoseconds(nextDue)));
+                    }
+                }
+
+                mDispatchThreadSleeping.store(false, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// @brief An event in a timer heap, its payload is in the scheduled payload pool so the heap only moves small
+    /// entries.
+    struct ScheduledEvent
+    {
+        /// @brief Clock time in nanoseconds or frame.
+        uint64_t Due;
+
+        /// @brief Keeps the scheduling order of events that are due at the same time.
+        uint64_t Sequence;
+
+        uint32_t Slot;
+
+        E Type;
+    };
+
+    /// @brief Heap order, the earliest event on top.
+    static bool IsDueLater(const ScheduledEvent& a, const ScheduledEvent& b)
+    {
+        return a.Due != b.Due ? a.Due > b.Due : a.Sequence > b.Sequence;
+    }
+
+    void ScheduleEvent(std::vector<ScheduledEvent>& timers, std::atomic<uint64_t>& nextDue, E eventType,
+                       const T& data, uint64_t due)
+    {
+        {
+            const std::lock_guard<std::mutex> lock(mTimerMutex);
+
+            timers.push_back({due, mScheduleSequence++, mScheduledPayloads.Acquire(data), eventType});
+            std::push_heap(timers.begin(), timers.end(), IsDueLater);
+
+            nextDue.store(timers.front().Due, std::memory_order_relaxed);
+            mScheduledEventCount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // The dispatch thread may sleep until a later event, or without a timeout.
+        if (mDispatchThreadRunning.load(std::memory_order_relaxed))
+        {
+            WakeDispatchThread();
+        }
+    }
+
+    /// @brief Moves the due events of a timer heap to the due batch. Called with the timer mutex held.
+    void PopDueEvents(std::vector<ScheduledEvent>& timers, std::atomic<uint64_t>& nextDue, uint64_t now,
+                      std::vector<std::pair<E, T>>& due)
+    {
+        while (!timers.empty() && timers.front().Due <= now)
+        {
+            std::pop_heap(timers.begin(), timers.end(), IsDueLater);
+
+            const ScheduledEvent& event = timers.back();
+            due.emplace_back(event.Type, std::move(mScheduledPayloads[event.Slot]));
+            mScheduledPayloads.Release(event.Slot);
+
+            timers.pop_back();
+            mScheduledEventCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        nextDue.store(timers.empty() ? NotDue : timers.front().Due, std::memory_order_relaxed);
+    }
+
+    /// @brief Dispatches the scheduled events that are due, the frame events first. The timer mutex is only held to
+    /// take them out of the heaps, so subscribers can schedule events.
+    void DispatchDueEvents()
+    {
+        // Taken from the member to keep its memory, a subscriber pumping the dispatcher uses its own batch.
+        std::vector<std::pair<E, T>> due;
+        due.swap(mDueEvents);
+
+        {
+            const std::lock_guard<std::mutex> lock(mTimerMutex);
+
+            PopDueEvents(mFrameTimers, mNextFrameDue, mFrame.load(std::memory_order_relaxed), due);
+            PopDueEvents(mClockTimers, mNextClockDue, DeadlineFromNow(std::chrono::nanoseconds(0)), due);
+        }
+
+        for (auto& [eventType, data] : due) { Dispatch(eventType, data); }
+
+        due.clear();
+        due.swap(mDueEvents);
+    }
+
+    /// @brief Checks if a clock event is due, for the dispatch thread.
+    bool IsClockEventDue() const
+    {
+        const uint64_t nextDue = mNextClockDue.load(std::memory_order_relaxed);
+        return nextDue != NotDue && nextDue <= DeadlineFromNow(std::chrono::nanoseconds(0));
+    }
+
+    /// @brief Checks if the owner or token of a lifetime tracked subscriber is gone.
+    static bool IsExpired(const Subscriber& sub) { return !(sub.Lifetime == nullptr) && sub.Lifetime.expired(); }
+
+    bool HasTrackedSubscribers()
+    {
+        const auto tracked = [](const Subscriber& sub) { return !(sub.Lifetime == nullptr); };
+        bool found = false;
+
+        for (const auto& [type, subs] : mEventSubscribers) { found |= std::any_of(subs.begin(), subs.end(), tracked); }
+
+        mChannelSubscribers.ForEach([&](const ChannelId&, std::vector<Subscriber>& subs) {
+            found |= std::any_of(subs.begin(), subs.end(), tracked);
+        });
+
+        return found;
+    }
+
+    void SubscribeTracked(E eventType, const EventFn& eventFn, WeakPointer<uint8_t> lifetime, Priority_t priority)
+    {
+        const EventEnum_t type = static_cast<EventEnum_t>(eventType);
+
+        Subscriber sub{eventFn, priority};
+        sub.Lifetime = std::move(lifetime);
+
+        const std::unique_lock<std::mutex> lock = LockSubscribers();
+
+        InsertSubscriber(GetSubscribers(type), sub);
+        PublishSubscribers(&type);
+    }
+
+    /// @brief Prunes the expired subscribers found by earlier dispatches, unless called from a subscriber since the
+    /// lists of the outer dispatches are still being walked.
+    void PruneIfRequested()
+    {
+        if (mPruneRequested && mCallDepth == 0)
+        {
+            PruneSubscribers();
+        }
+    }
+
+    /// @brief Filter results of a subscriber list in a batch of queued events.
+    struct FilterBatchList
+    {
+        EventEnum_t Type;
+
+        /// @brief The list the results belong to, only compared.
+        const std::vector<Subscriber>* Subscribers;
+
+        /// @brief Match mask of every subscriber by its index in the list, empty if none has a filter.
+        std::vector<uint64_t> Matches;
+    };
+
+    /// @brief Filters of the next queued events, evaluated before they are dispatched.
+    struct FilterBatch
+    {
+        /// @brief Position of the first event of the batch in the count of dispatched queued events.
+        uint64_t Start = 0;
+
+        uint32_t Count = 0;
+
+        /// @brief Subscriber version the filters were evaluated with, a newer one makes the results stale.
+        uint64_t Version = 0;
+
+        /// @brief Only the first ListCount lists and ColumnCount columns are used, the others keep their memory.
+        std::vector<FilterBatchList> Lists;
+
+        uint32_t ListCount = 0;
+
+        std::vector<typename EventFilter::Column> Columns;
+
+        uint32_t ColumnCount = 0;
+
+        const T* Events[EventFilter::BatchSize];
+    };
+
+    /// @brief Called before dispatching the event at the front of a queue. Evaluates the filters of the next batch
+    /// once the current one is used up, and lets CallSubscribers() use the batch for the event.
+    void PrepareFilterBatch(EventQueue& queue)
+    {
+        if (!mHasFilters.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        if (mQueuedDispatchCount - mFilterBatch.Start >= mFilterBatch.Count)
+        {
+            EvaluateFilters(queue);
+        }
+
+        mFilterEvent = mQueuedDispatchCount;
+    }
+
+    /// @brief Evaluates the filters of every subscriber of the first events of a queue. The filtered field is
+    /// loaded into a column once per batch, however many filters use it.
+    void EvaluateFilters(EventQueue& queue)
+    {
+        FilterBatch& batch = mFilterBatch;
+
+        batch.Start = mQueuedDispatchCount;
+        batch.Count = static_cast<uint32_t>(std::min<size_t>(queue.size(), EventFilter::BatchSize));
+        batch.Version = mSubscriberVersion.load(std::memory_order_acquire);
+        batch.ListCount = 0;
+        batch.ColumnCount = 0;
+
+        for (uint32_t i = 0; i < batch.Count; i++) { batch.Events[i] = &GetQueuedData(queue[i]); }
+
+        std::optional<SnapshotReader> reader;
+
+        if (mConcurrent)
+        {
+            reader.emplace(*this);
+        }
+
+        for (uint32_t i = 0; i < batch.Count; i++)
+        {
+            const EventEnum_t type = static_cast<EventEnum_t>(queue[i].first);
+
+            const auto evaluated = std::find_if(batch.Lists.begin(), batch.Lists.begin() + batch.ListCount,
+                                                [type](const FilterBatchList& list) { return list.Type == type; });
+
+            if (evaluated != batch.Lists.begin() + batch.ListCount)
+            {
+                continue;
+            }
+
+            if (batch.ListCount == batch.Lists.size())
+            {
+                batch.Lists.emplace_back();
+            }
+
+            FilterBatchList& list = batch.Lists[batch.ListCount++];
+            list.Type = type;
+            list.Subscribers = reader ? reader->Find(type) : FindSubscribers(type);
+            list.Matches.clear();
+
+            if (!list.Subscribers)
+            {
+                continue;
+            }
+
+            const std::vector<Subscriber>& subs = *list.Subscribers;
+
+            for (size_t s = 0; s < subs.size(); s++)
+            {
+                if (subs[s].Filter.IsActive())
+                {
+                    list.Matches.resize(subs.size());
+                    list.Matches[s] = subs[s].Filter.Match(GetFilterColumn(subs[s].Filter), batch.Count);
+                }
+            }
+        }
+    }
+
+    /// @brief Get the column of the field of a filter in the current batch, gathering it the first time.
+    const typename EventFilter::Column& GetFilterColumn(const EventFilter& filter)
+    {
+        FilterBatch& batch = mFilterBatch;
+
+        for (uint32_t c = 0; c < batch.ColumnCount; c++)
+        {
+            if (batch.Columns[c].Field.HasSameField(filter))
+            {
+                return batch.Columns[c];
+            }
+        }
+
+        if (batch.ColumnCount == batch.Columns.size())
+        {
+            batch.Columns.emplace_back();
+        }
+
+        typename EventFilter::Column& column = batch.Columns[batch.ColumnCount++];
+        filter.Gather(batch.Events, batch.Count, column);
+
+        return column;
+    }
+
+    /// @brief Finds the filter results of a queued event in the current batch.
+    /// @param subs The subscriber list the event is dispatched to.
+    /// @param event Position of the event in the count of dispatched queued events.
+    /// @param bit Set to the bit of the event in the match masks.
+    /// @return The match masks by subscriber index, or null if the results are missing or stale.
+    const uint64_t* FindBatchMatches(E eventType, const std::vector<Subscriber>* subs, uint64_t event, uint32_t& bit)
+    {
+        const FilterBatch& batch = mFilterBatch;
+
+        if (!subs || event - batch.Start >= batch.Count ||
+            batch.Version != mSubscriberVersion.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        for (uint32_t l = 0; l < batch.ListCount; l++)
+        {
+            const FilterBatchList& list = batch.Lists[l];
+
+            if (list.Type == static_cast<EventEnum_t>(eventType) && list.Subscribers == subs && !list.Matches.empty())
+            {
+                bit = static_cast<uint32_t>(event - batch.Start);
+                return list.Matches.data();
+            }
+        }
+
+        return nullptr;
+    }
+
+    /// @brief Drops the filter results of the batch after a queued payload changed or an event was erased.
+    /// Double buffered producers only change their own queue, the batch belongs to the drain queue.
+    void InvalidateFilterBatch()
+    {
+        if (!mDoubleBuffered)
+        {
+            mFilterBatch.Count = 0;
+        }
+    }
+
+    /// @brief Calls the subscribers of both lists merged in priority order, until the event is consumed.
+    /// @param broadcast Subscribers without a channel, can be null.
+    /// @param channel Subscribers on the channel, can be null.
+    void CallSubscribers(E eventType, std::vector<Subscriber>* broadcast, std::vector<Subscriber>* channel, T& data)
+    {
+#ifdef UTILLIB_EVENT_METRICS
+        EventMetrics::EventTypeMetrics& metrics = GetEventMetrics(eventType);
+        const uint64_t dispatchStart = EventMetrics::Now();
+        metrics.DispatchCount++;
+#endif
+
+        Subscriber* a = broadcast ? broadcast->data() : nullptr;
+        Subscriber* const aEnd = broadcast ? a + broadcast->size() : nullptr;
+        Subscriber* b = channel ? channel->data() : nullptr;
+        Subscriber* const bEnd = channel ? b + channel->size() : nullptr;
+
+        // Filter results evaluated in bulk, if this is a queued event of the current batch. Events the subscribers
+        // dispatch aren't part of the batch.
+        uint32_t batchBit = 0;
+        const uint64_t* batchMatches = nullptr;
+
+        if (mFilterEvent != NoFilterEvent)
+        {
+            batchMatches = FindBatchMatches(eventType, broadcast, mFilterEvent, batchBit);
+            mFilterEvent = NoFilterEvent;
+        }
+
+        // Subscribers may dispatch other events, so save the state of the outer dispatch.
+        const bool outerStopped = mPropagationStopped;
+        mPropagationStopped = false;
+        mCallDepth++;
+
+        while (a != aEnd || b != bEnd)
+        {
+            const bool fromBroadcast = b == bEnd || (a != aEnd && a->Priority >= b->Priority);
+            Subscriber& sub = fromBroadcast ? *a++ : *b++;
+
+            if (IsExpired(sub))
+            {
+                // The list can't change while it's walked, prune it at the start of the next outer dispatch.
+                mPruneRequested = true;
+                continue;
+            }
+
+            if (sub.Filter.IsActive())
+            {
+                const bool matches = batchMatches && fromBroadcast
+                                         ? (batchMatches[a - 1 - broadcast->data()] >> batchBit) & 1
+                                         : sub.Filter.Matches(data);
+
+                if (!matches)
+                {
+                    continue;
+                }
+            }
+
+#ifdef UTILLIB_EVENT_METRICS
+            const uint64_t callStart = EventMetrics::Now();
+#endif
+
+            if (sub.Mailbox)
+            {
+                sub.Mailbox->Post(sub.Fn, static_cast<const T&>(data));
+            }
+            else
+            {
+                sub.Fn(data);
+            }
+
+#ifdef UTILLIB_EVENT_METRICS
+            const uint64_t callDuration = EventMetrics::Now() - callStart;
+            sub.CallCount++;
+            sub.TotalNanoseconds += callDuration;
+            RecordSpan(eventType, static_cast<int32_t>(fromBroadcast ? a - broadcast->data() : b - channel->data()) - 1,
+                       callStart, callDuration);
+#endif
+
+            if (mPropagationStopped)
+            {
+                break; // The event was consumed.
+            }
+        }
+
+        // Coroutines waiting for the event are resumed after the subscribers, unless a subscriber consumed it.
+        if (mAwaiterCount != 0 && !mPropagationStopped)
+        {
+            ResumeAwaiters(eventType, data);
+        }
+
+        mPropagationStopped = outerStopped;
+        mCallDepth--;
+
+#ifdef UTILLIB_EVENT_METRICS
+        const uint64_t dispatchDuration = EventMetrics::Now() - dispatchStart;
+        metrics.DispatchNanoseconds += dispatchDuration;
+        RecordSpan(eventType, -1, dispatchStart, dispatchDuration);
+#endif
+    }
+
+    /// @brief Coalesce policy of an event type, and the sequence numbers of the events it can coalesce into.
+    struct CoalesceRule
+    {
+        CoalescePolicy Policy = CoalescePolicy::None;
+
+        MergeFn Merge;
+
+        KeyFn Key;
+
+        /// @brief Sequence number of the last queued event of this type, for LatestWins and Merge.
+        uint64_t LastSequence = 0;
+
+        /// @brief Whether LastSequence refers to an event that was queued.
+        bool HasLast = false;
+
+        /// @brief Sequence numbers of the queued events by key, for DropDuplicates.
+        FlatHashMap<uint64_t, uint64_t> KeyedSlots;
+    };
+
+    CoalesceRule& SetCoalesceRule(E eventType, CoalescePolicy policy)
+    {
+        auto& rule = mCoalesceRules[static_cast<EventEnum_t>(eventType)];
+        rule.Policy = policy;
+        rule.HasLast = false;
+        rule.KeyedSlots.Clear();
+        return rule;
+    }
+
+    /// @brief Result of pushing an event to the queue.
+    enum class PushResult : uint8_t
+    {
+        Queued,
+        Coalesced,
+        Dropped,
+
+        /// @brief The queue is full and the overflow policy is Block.
+        Full,
+    };
+
+    /// @brief Capacity and overflow policy of the queue or of an event type.
+    struct CapacityRule
+    {
+        size_t Capacity = 0;
+
+        OverflowPolicy Policy = OverflowPolicy::DropNewest;
+
+        OverflowFn Overflow;
+
+        /// @brief Number of queued events the rule applies to, decremented by the consumer.
+        std::atomic<size_t> Count = 0;
+
+        CapacityRule() = default;
+
+        CapacityRule(size_t capacity, OverflowPolicy policy, const OverflowFn& overflow)
+            : Capacity(capacity), Policy(policy), Overflow(overflow)
+        {
+        }
+
+        CapacityRule& operator=(const CapacityRule& other)
+        {
+            Capacity = other.Capacity;
+            Policy = other.Policy;
+            Overflow = other.Overflow;
+            Count.store(other.Count.load());
+            return *this;
+        }
+    };
+
+    using RecordKind = EventRecordKind;
+
+    /// @brief Circular list of awaiters with a sentinel node, node based in the map so the sentinel never moves.
+    struct AwaiterList
+    {
+        AwaiterList() { Head.Prev = Head.Next = &Head; }
+
+        struct Sentinel : AwaiterNode
+        {
+            ~Sentinel() { this->Next = nullptr; }
+        };
+
+        Sentinel Head;
+    };
+
+    static uint64_t DeadlineFromNow(std::chrono::nanoseconds timeout)
+    {
+        const auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now + timeout).count());
+    }
+
+    static void LinkBefore(AwaiterNode& node, AwaiterNode& position)
+    {
+        node.Prev = position.Prev;
+        node.Next = &position;
+        position.Prev->Next = &node;
+        position.Prev = &node;
+    }
+
+    static void Unlink(AwaiterNode& node)
+    {
+        node.Prev->Next = node.Next;
+        node.Next->Prev = node.Prev;
+        node.Prev = node.Next = nullptr;
+    }
+
+    void LinkAwaiter(AwaiterNode& node, E eventType)
+    {
+        LinkBefore(node, mAwaiters[static_cast<EventEnum_t>(eventType)].Head);
+
+        mAwaiterCount++;
+        mTimedAwaiterCount += node.Deadline != 0;
+    }
+
+    void UnlinkAwaiter(AwaiterNode& node)
+    {
+        Unlink(node);
+
+        mAwaiterCount--;
+        mTimedAwaiterCount -= node.Deadline != 0;
+    }
+
+    /// @brief Resumes the awaiters of the event whose predicate matches, in the order they started waiting.
+    void ResumeAwaiters(E eventType, const T& data)
+    {
+        const auto found = mAwaiters.find(static_cast<EventEnum_t>(eventType));
+
+        if (found == mAwaiters.end() || found->second.Head.Next == &found->second.Head)
+        {
+            return;
+        }
+
+        // Move the waiting awaiters to a local list first. Resumed coroutines can wait again or destroy other
+        // waiting coroutines, this way new awaiters wait for the next dispatch and destroyed ones unlink safely.
+        AwaiterNode& head = found->second.Head;
+        typename AwaiterList::Sentinel pending;
+        pending.Next = head.Next;
+        pending.Prev = head.Prev;
+        pending.Next->Prev = &pending;
+        pending.Prev->Next = &pending;
+        head.Next = head.Prev = &head;
+
+        while (pending.Next != &pending)
+        {
+            AwaiterNode& node = *pending.Next;
+            Unlink(node);
+
+            if (node.Matches && !node.Matches(node, data))
+            {
+                LinkBefore(node, head);
+                continue;
+            }
+
+            mAwaiterCount--;
+            mTimedAwaiterCount -= node.Deadline != 0;
+
+            node.Data = &data;
+            node.Handle.resume();
+        }
+    }
+
+    /// @brief Resumes the awaiters whose timeout expired, with no data.
+    void ExpireAwaiters()
+    {
+        const uint64_t now = DeadlineFromNow(std::chrono::nanoseconds(0));
+        typename AwaiterList::Sentinel expired;
+        expired.Next = expired.Prev = &expired;
+
+        for (auto& [type, list] : mAwaiters)
+        {
+            for (AwaiterNode* node = list.Head.Next; node != &list.Head;)
+            {
+                AwaiterNode* next = node->Next;
+
+                if (node->Deadline != 0 && node->Deadline <= now)
+                {
+                    Unlink(*node);
+                    LinkBefore(*node, expired);
+                }
+
+                node = next;
+            }
+        }
+
+        while (expired.Next != &expired)
+        {
+            AwaiterNode& node = *expired.Next;
+            Unlink(node);
+
+            mAwaiterCount--;
+            mTimedAwaiterCount--;
+
+            node.Data = nullptr;
+            node.Handle.resume();
+        }
+    }
+
+    /// @brief Records a call made from outside the dispatcher, calls made by subscribers are not recorded since
+    /// the subscribers make them again when the recording is replayed.
+    void RecordCall(RecordKind kind, E eventType = E(), ChannelKey_t key = 0, const T* data = nullptr)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            if (mRecording == nullptr || mCallDepth != 0)
+            {
+                return;
+            }
+
+            if (data == nullptr)
+            {
+                mRecording->Record(kind);
+            }
+            else if (kind == RecordKind::DispatchChannel)
+            {
+                mRecording->Record(kind, eventType, key, *data);
+            }
+            else
+            {
+                mRecording->Record(kind, eventType, *data);
+            }
+        }
+    }
+
+    /// @brief Coalesces or pushes the event to the producer queue, applying the capacity rules.
+    PushResult PushEvent(E eventType, const T& data)
+    {
+#ifdef UTILLIB_EVENT_METRICS
+        GetEventMetrics(eventType).QueuedCount++;
+#endif
+
+        CoalesceRule* coalesceRule = nullptr;
+        uint64_t coalesceKey = 0;
+
+        if (!mCoalesceRules.empty() && TryCoalesce(eventType, data, coalesceRule, coalesceKey))
+        {
+            mCoalescedEventCount++;
+            return PushResult::Coalesced;
+        }
+
+        CapacityRule* typeRule = nullptr;
+
+        if (mBounded)
+        {
+            const auto found = mCapacityRules.find(static_cast<EventEnum_t>(eventType));
+            typeRule = found != mCapacityRules.end() ? &found->second : nullptr;
+
+            // Make room in the event type first, dropping an event of the type also makes room in the queue.
+            for (CapacityRule* rule : {typeRule, &mCapacity})
+            {
+                if (rule && rule->Capacity != 0 && rule->Count.load(std::memory_order_acquire) >= rule->Capacity)
+                {
+                    const PushResult result = Overflow(*rule, rule == typeRule, eventType, data);
+
+                    if (result != PushResult::Queued)
+                    {
+                        return result;
+                    }
+                }
+            }
+
+            mCapacity.Count.fetch_add(1, std::memory_order_relaxed);
+
+            if (typeRule)
+            {
+                typeRule->Count.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        if constexpr (PooledPayloads)
+        {
+            mEventQueue.emplace_back(eventType, mPayloadPool.Acquire(data));
+        }
+        else
+        {
+            mEventQueue.emplace_back(eventType, data);
+        }
+
+        if (coalesceRule)
+        {
+            RegisterCoalesceSlot(*coalesceRule, coalesceKey);
+        }
+
+#ifdef UTILLIB_EVENT_METRICS
+        mEventQueueTimes.push_back(EventMetrics::Now());
+        mQueueHighWaterMark = std::max<uint64_t>(mQueueHighWaterMark, mEventQueue.size() + mDrainQueue.size());
+#endif
+
+        return PushResult::Queued;
+    }
+
+    /// @brief Applies the overflow policy of a full capacity rule.
+    /// @param perType Whether the rule is the rule of the event type or the rule of the whole queue.
+    /// @return PushResult::Queued if room was made for the event.
+    PushResult Overflow(CapacityRule& rule, bool perType, E eventType, const T& data)
+    {
+        switch (rule.Policy)
+        {
+        case OverflowPolicy::Block:
+            // The consumer can't drain the queue while it waits for itself.
+            if (mDoubleBuffered && mConsumerThread.load(std::memory_order_relaxed) != std::this_thread::get_id())
+            {
+                return PushResult::Full;
+            }
+
+            if (rule.Overflow != OverflowFn())
+            {
+                rule.Overflow(eventType, data);
+            }
+            break;
+
+        case OverflowPolicy::DropOldest:
+            // Only the producer queue is searched, double buffered events that were swapped belong to the consumer.
+            for (size_t i = mFirstPendingSequence - mFrontSequence; i < mEventQueue.size(); i++)
+            {
+                if ((!perType || mEventQueue[i].first == eventType) && !IsDroppedSequence(mFrontSequence + i))
+                {
+                    CountDroppedEvent(mEventQueue[i].first);
+                    EraseQueuedEvent(i);
+                    return PushResult::Queued;
+                }
+            }
+            break;
+
+        case OverflowPolicy::Coalesce:
+            for (size_t i = mEventQueue.size(); i > mFirstPendingSequence - mFrontSequence; i--)
+            {
+                if (mEventQueue[i - 1].first == eventType && !IsDroppedSequence(mFrontSequence + i - 1))
+                {
+                    GetQueuedData(mEventQueue[i - 1]) = data;
+                    InvalidateFilterBatch();
+                    mCoalescedEventCount++;
+                    return PushResult::Coalesced;
+                }
+            }
+            break;
+
+        case OverflowPolicy::Callback:
+            rule.Overflow(eventType, data);
+            break;
+
+        case OverflowPolicy::DropNewest:
+            break;
+        }
+
+        CountDroppedEvent(eventType);
+        return PushResult::Dropped;
+    }
+
+    /// @brief Get the data of a queued event, from its pool slot if payloads are pooled.
+    T& GetQueuedData(typename EventQueue::value_type& event)
+    {
+        if constexpr (PooledPayloads)
+        {
+            return mPayloadPool[event.second];
+        }
+        else
+        {
+            return event.second;
+        }
+    }
+
+    /// @brief Erases a pending event from the middle of the producer queue. Only done on overflow, since the
+    /// following events shift and the coalesce slots pointing at them have to be renumbered.
+    /// While DispatchQueuedEvents() dispatches the front event of the queue, erasing would invalidate its reference,
+    /// so the event is only marked as dropped then and skipped when it reaches the front.
+    void EraseQueuedEvent(size_t index)
+    {
+        OnEventRemoved(mEventQueue[index].first);
+
+        if (mFirstPendingSequence != mFrontSequence)
+        {
+            const uint64_t dropped = mFrontSequence + index;
+            mDroppedSequences.push_back(dropped);
+
+            for (auto& [type, rule] : mCoalesceRules)
+            {
+                if (rule.HasLast && rule.LastSequence == dropped)
+                {
+                    rule.HasLast = false;
+                }
+
+                uint64_t droppedKey = 0;
+                bool hasDroppedKey = false;
+
+                rule.KeyedSlots.ForEach([&](uint64_t key, uint64_t& sequence) {
+                    if (sequence == dropped)
+                    {
+                        droppedKey = key;
+                        hasDroppedKey = true;
+                    }
+                });
+
+                if (hasDroppedKey)
+                {
+                    rule.KeyedSlots.Erase(droppedKey);
+                }
+            }
+
+            return;
+        }
+
+        if constexpr (PooledPayloads)
+        {
+            mPayloadPool.Release(mEventQueue[index].second);
+        }
+
+        mEventQueue.erase(mEventQueue.begin() + index);
+        InvalidateFilterBatch();
+
+#ifdef UTILLIB_EVENT_METRICS
+        mEventQueueTimes.erase(mEventQueueTimes.begin() + index);
+#endif
+
+        const uint64_t erased = mFrontSequence + index;
+
+        for (auto& [type, rule] : mCoalesceRules)
+        {
+            if (rule.HasLast && rule.LastSequence >= erased)
+            {
+                rule.HasLast = rule.LastSequence != erased;
+                rule.LastSequence--;
+            }
+
+            uint64_t erasedKey = 0;
+            bool hasErasedKey = false;
+
+            rule.KeyedSlots.ForEach([&](uint64_t key, uint64_t& sequence) {
+                if (sequence == erased)
+                {
+                    erasedKey = key; // At most one slot points at an event.
+                    hasErasedKey = true;
+                }
+                else if (sequence > erased)
+                {
+                    sequence--;
+                }
+            });
+
+            if (hasErasedKey)
+            {
+                rule.KeyedSlots.Erase(erasedKey);
+            }
+        }
+    }
+
+    bool IsDroppedSequence(uint64_t sequence) const
+    {
+        return std::find(mDroppedSequences.begin(), mDroppedSequences.end(), sequence) != mDroppedSequences.end();
+    }
+
+    /// @brief Removes the mark of an event that was dropped during a dispatch.
+    /// @return True if the event was dropped.
+    bool RemoveDroppedSequence(uint64_t sequence)
+    {
+        const auto found = std::find(mDroppedSequences.begin(), mDroppedSequences.end(), sequence);
+
+        if (found == mDroppedSequences.end())
+        {
+            return false;
+        }
+
+        *found = mDroppedSequences.back();
+        mDroppedSequences.pop_back();
+        return true;
+    }
+
+    /// @brief Updates the capacity counters when an event leaves the queue.
+    void OnEventRemoved(E eventType)
+    {
+        if (!mBounded)
+        {
+            return;
+        }
+
+        mCapacity.Count.fetch_sub(1, std::memory_order_release);
+
+        const auto found = mCapacityRules.find(static_cast<EventEnum_t>(eventType));
+
+        if (found != mCapacityRules.end())
+        {
+            found->second.Count.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    void CountDroppedEvent(E eventType)
+    {
+        mDroppedEventCount.fetch_add(1, std::memory_order_relaxed);
+        mDroppedEventCounts[static_cast<EventEnum_t>(eventType)]++;
+    }
+
+    /// @brief Coalesces the event into an already queued event if the coalesce policy allows it.
+    /// @param rule Set to the coalesce rule of the event type if the event wasn't coalesced, so the event can be
+    /// registered with RegisterCoalesceSlot() once it's queued.
+    /// @param key Set to the deduplication key of the event.
+    /// @return True if the event was coalesced and must not be queued.
+    bool TryCoalesce(E eventType, const T& data, CoalesceRule*& rule, uint64_t& key)
+    {
+        const auto found = mCoalesceRules.find(static_cast<EventEnum_t>(eventType));
+
+        if (found == mCoalesceRules.end())
+        {
+            return false;
+        }
+
+        if (found->second.Policy == CoalescePolicy::DropDuplicates)
+        {
+            key = found->second.Key(data);
+            const uint64_t* slot = found->second.KeyedSlots.Find(key);
+
+            if (slot && *slot >= mFirstPendingSequence)
+            {
+                return true; // Duplicate is still queued.
+            }
+        }
+        else if (found->second.HasLast && found->second.LastSequence >= mFirstPendingSequence)
+        {
+            T& queued = GetQueuedData(mEventQueue[found->second.LastSequence - mFrontSequence]);
+
+            if (found->second.Policy == CoalescePolicy::Merge)
+            {
+                found->second.Merge(queued, data);
+            }
+            else
+            {
+                queued = data;
+            }
+
+            InvalidateFilterBatch();
+
+            return true;
+        }
+
+        rule = &found->second;
+        return false;
+    }
+
+    /// @brief Makes the event at the back of the queue the one later events of its type coalesce into.
+    void RegisterCoalesceSlot(CoalesceRule& rule, uint64_t key)
+    {
+        const uint64_t sequence = mFrontSequence + mEventQueue.size() - 1;
+
+        if (rule.Policy == CoalescePolicy::DropDuplicates)
+        {
+            rule.KeyedSlots[key] = sequence;
+        }
+        else
+        {
+            rule.LastSequence = sequence;
+            rule.HasLast = true;
+        }
+    }
+
+    SubscriberMap mEventSubscribers;
+
+    FlatHashMap<ChannelId, std::vector<Subscriber>, ChannelIdHash> mChannelSubscribers;
+
+    /// @brief Wildcard subscribers in subscription order, resolved into the lists of the matching events.
+    std::vector<Subscriber> mWildcardSubscribers;
+
+    std::unordered_map<EventEnum_t, CategoryMask_t> mEventCategories;
+
+    std::thread mDispatchThread;
+
+    std::atomic<bool> mStopDispatchThread = false;
+
+    /// @brief Whether QueueEvent() has to wake the dispatch thread.
+    std::atomic<bool> mDispatchThreadRunning = false;
+
+    /// @brief Incremented by every QueueEvent() while the dispatch thread runs, the dispatch thread sleeps until it
+    /// changes.
+    std::atomic<uint32_t> mQueuedSignal = 0;
+
+    /// @brief Whether the dispatch thread sleeps and has to be notified.
+    std::atomic<bool> mDispatchThreadSleeping = false;
+
+    std::mutex mDispatchThreadMutex;
+
+    std::condition_variable mDispatchThreadWake;
+
+    /// @brief Due time of a timer heap without events.
+    static constexpr uint64_t NotDue = ~uint64_t(0);
+
+    /// @brief Guards the timer heaps and the scheduled payloads, events can be scheduled from any thread.
+    std::mutex mTimerMutex;
+
+    /// @brief Heaps of the events scheduled by clock time and by frame.
+    std::vector<ScheduledEvent> mClockTimers;
+
+    std::vector<ScheduledEvent> mFrameTimers;
+
+    EventPayloadPool<T> mScheduledPayloads;
+
+    uint64_t mScheduleSequence = 0;
+
+    /// @brief Due time of the top of each heap, read without the mutex.
+    std::atomic<uint64_t> mNextClockDue = NotDue;
+
+    std::atomic<uint64_t> mNextFrameDue = NotDue;
+
+    std::atomic<size_t> mScheduledEventCount = 0;
+
+    std::atomic<uint64_t> mFrame = 0;
+
+    /// @brief Batch of due events, kept to reuse its memory.
+    std::vector<std::pair<E, T>> mDueEvents;
+
+    /// @brief Set when a dispatch skipped an expired subscriber.
+    bool mPruneRequested = false;
+
+    /// @brief Whether subscriber lists are published as snapshots, see EnableConcurrentSubscriptions().
+    bool mConcurrent = false;
+
+    std::atomic<SubscriberSnapshot*> mSnapshot = nullptr;
+
+    /// @brief Its lowest bit selects the reader counter new dispatches use.
+    std::atomic<uint32_t> mSnapshotEpoch = 0;
+
+    /// @brief Number of dispatches reading a snapshot, by epoch parity.
+    std::atomic<uint32_t> mSnapshotReaders[2] = {};
+
+    /// @brief Serializes the writers of the subscriber lists in the concurrent mode.
+    std::mutex mSubscriberMutex;
+
+    /// @brief Replaced snapshots waiting for the next grace period.
+    std::vector<SubscriberSnapshot*> mRetiredSnapshots;
+
+    /// @brief Replaced snapshots freed at the end of the current grace period.
+    std::vector<SubscriberSnapshot*> mGraceSnapshots;
+
+    /// @brief 0 without a grace period, otherwise the number of the reader counter check it waits for.
+    uint32_t mGracePhase = 0;
+
+    /// @brief Parity of the reader counter the grace period waits for.
+    uint32_t mGraceParity = 0;
+
+    /// @brief Queue events are pushed to. When double buffering it's the producer side.
+    EventQueue mEventQueue;
+
+    /// @brief Consumer side of the double buffered queues, drained by DispatchQueuedEvents().
+    EventQueue mDrainQueue;
+
+    /// @brief Payloads of the queued events if they are pooled. Owned by the producer when double buffering.
+    [[no_unique_address]] std::conditional_t<PooledPayloads, EventPayloadPool<T>, std::monostate> mPayloadPool;
+
+    bool mDoubleBuffered = false;
+
+    std::atomic<bool> mProducerWriting = false;
+
+    std::atomic<bool> mSwapping = false;
+
+    /// @brief Thread that last called SwapEventQueues(), OverflowPolicy::Block doesn't wait on it.
+    std::atomic<std::thread::id> mConsumerThread;
+
+    /// @brief Sequence number of the event at the front of the queue.
+    uint64_t mFrontSequence = 0;
+
+    /// @brief Sequence number of the first event that hasn't been dispatched yet.
+    uint64_t mFirstPendingSequence = 0;
+
+    /// @brief Sequence numbers of the events OverflowPolicy::DropOldest dropped while an event was dispatched. They
+    /// stay in the queue until they reach the front, see EraseQueuedEvent().
+    std::vector<uint64_t> mDroppedSequences;
+
+    std::unordered_map<EventEnum_t, CoalesceRule> mCoalesceRules;
+
+    uint64_t mCoalescedEventCount = 0;
+
+    /// @brief Whether any capacity is set, the counters are only maintained then.
+    bool mBounded = false;
+
+    /// @brief Capacity of the whole queue.
+    CapacityRule mCapacity;
+
+    std::unordered_map<EventEnum_t, CapacityRule> mCapacityRules;
+
+    std::atomic<uint64_t> mDroppedEventCount = 0;
+
+    std::unordered_map<EventEnum_t, uint64_t> mDroppedEventCounts;
+
+    /// @brief Whether any subscriber has a filter, the queued events are only batched then.
+    std::atomic<bool> mHasFilters = false;
+
+    /// @brief Incremented by every change of the subscriber lists.
+    std::atomic<uint64_t> mSubscriberVersion = 0;
+
+    /// @brief Number of queued events that were dispatched, positions the filter batch in the queue.
+    uint64_t mQueuedDispatchCount = 0;
+
+    static constexpr uint64_t NoFilterEvent = ~uint64_t(0);
+
+    /// @brief Position of the queued event the next CallSubscribers() is for, NoFilterEvent for other dispatches.
+    uint64_t mFilterEvent = NoFilterEvent;
+
+    FilterBatch mFilterBatch;
+
+#ifdef UTILLIB_EVENT_METRICS
+    EventMetrics::EventTypeMetrics& GetEventMetrics(E eventType)
+    {
+        return mEventMetrics[static_cast<EventEnum_t>(eventType)];
+    }
+
+    void RecordSpan(E eventType, int32_t subscriber, uint64_t start, uint64_t duration)
+    {
+        if (mTraceSpans.size() < mMaxTraceSpans)
+        {
+            mTraceSpans.push_back({static_cast<int64_t>(eventType), subscriber, start, duration});
+        }
+    }
+
+    std::unordered_map<EventEnum_t, EventMetrics::EventTypeMetrics> mEventMetrics;
+
+    /// @brief Time each queued event was queued at, parallel to mEventQueue and mDrainQueue.
+    std::deque<uint64_t> mEventQueueTimes;
+
+    std::deque<uint64_t> mDrainQueueTimes;
+
+    uint64_t mQueueHighWaterMark = 0;
+
+    std::vector<EventMetrics::TraceSpan> mTraceSpans;
+
+    size_t mMaxTraceSpans = 0;
+#endif
+
+    bool mPropagationStopped = false;
+
+    /// @brief Number of nested calls into subscribers and DispatchQueuedEvents(), 0 when called from outside.
+    uint32_t mCallDepth = 0;
+
+    EventRecording<E, T>* mRecording = nullptr;
+
+    std::unordered_map<EventEnum_t, AwaiterList> mAwaiters;
+
+    size_t mAwaiterCount = 0;
+
+    size_t mTimedAwaiterCount = 0;
 };
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "Function.h"
+
+/// @brief EventMailbox is a queue of subscriber calls owned by a thread (render, audio, ...). EventDispatcher posts
+/// the calls of the subscribers that subscribed with a mailbox into it instead of calling them on the dispatching
+/// thread, and the owner thread runs them at its own pump point with Pump(). That way the subscriber code runs on
+/// its own thread and doesn't need locks.
+/// Any number of threads can post, only the owner thread pumps. Posting is lock-free (one atomic exchange), it's
+/// the multi-producer single-consumer queue of Dmitry Vyukov. Every posted call allocates one node holding a copy
+/// of the data.
+class EventMailbox
+{
+public:
+    EventMailbox() : mHead(&mStub), mTail(&mStub) {}
+
+    EventMailbox(const EventMailbox&) = delete;
+
+    EventMailbox& operator=(const EventMailbox&) = delete;
+
+    /// @brief Destroys the calls that were never pumped, without running them.
+    ~EventMailbox()
+    {
+        while (Node* node = PopNode())
+        {
+            node->Destroy(node);
+        }
+    }
+
+    /// @brief Posts a call to the mailbox. Can be called from any thread.
+    /// @tparam T The data type.
+    /// @param fn The function to call on the owner thread.
+    /// @param data The data, copied into the mailbox.
+    template<typename T>
+    void Post(const Function<void(const T&)>& fn, const T& data)
+    {
+        Push(new Message<T>(fn, data));
+    }
+
+    /// @brief Runs all the posted calls in the order they were posted. Only called by the owner thread.
+    /// @return The number of calls that were run.
+    size_t Pump()
+    {
+        size_t count = 0;
+
+        while (Node* node = PopNode())
+        {
+            node->Invoke(node);
+            node->Destroy(node);
+            count++;
+        }
+
+        return count;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> Next = nullptr;
+
+        void (*Invoke)(Node*) = nullptr;
+
+        void (*Destroy)(Node*) = nullptr;
+    };
+
+    template<typename T>
+    struct Message : Node
+    {
+        Message(const Function<void(const T&)>& fn, const T& data) : Fn(fn), Data(data)
+        {
+            this->Invoke = [](Node* node) {
+                Message* message = static_cast<Message*>(node);
+                message->Fn(message->Data);
+            };
+            this->Destroy = [](Node* node) { delete static_cast<Message*>(node); };
+        }
+
+        Function<void(const T&)> Fn;
+
+        T Data;
+    };
+
+    void Push(Node* node)
+    {
+        node->Next.store(nullptr, std::memory_order_relaxed);
+
+        // Link the node as the new head, then publish it to the previous head. The consumer waits for the link if it
+        // reaches the previous head before it's published.
+        Node* prev = mHead.exchange(node, std::memory_order_acq_rel);
+        prev->Next.store(node, std::memory_order_release);
+    }
+
+    /// @brief Pops the oldest node, the stub node is cycled back into the queue when it's reached.
+    /// @return The node, or nullptr if the queue is empty or the next node is still being linked.
+    Node* PopNode()
+    {
+        Node* tail = mTail;
+        Node* next = tail->Next.load(std::memory_order_acquire);
+
+        if (tail == &mStub)
+        {
+            if (next == nullptr)
+            {
+                return nullptr;
+            }
+
+            mTail = next;
+            tail = next;
+            next = next->Next.load(std::memory_order_acquire);
+        }
+
+        if (next)
+        {
+            mTail = next;
+            return tail;
+        }
+
+        if (tail != mHead.load(std::memory_order_acquire))
+        {
+            return nullptr; // A producer is linking a node after the tail, it will be popped in the next Pump().
+        }
+
+        // The tail is the last node, push the stub behind it so the tail can be popped.
+        Push(&mStub);
+
+        next = tail->Next.load(std::memory_order_acquire);
+
+        if (next)
+        {
+            mTail = next;
+            return tail;
+        }
+
+        return nullptr;
+    }
+
+    /// @brief Most recently pushed node, producers exchange it.
+    std::atomic<Node*> mHead;
+
+    /// @brief Oldest node, only touched by the consumer.
+    Node* mTail;
+
+    /// @brief Dummy node so the queue is never empty, which keeps pushing to a single exchange.
+    Node mStub;
+};
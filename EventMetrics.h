@@ -0,0 +1,191 @@
+#pragma once
+
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/// Instrumentation used by EventDispatcher. Metrics are opt-in: define UTILLIB_EVENT_METRICS (or configure CMake with
+/// -DUTILLIB_EVENT_METRICS=ON) to record them, otherwise the recording code is compiled out of the dispatcher
+/// entirely and it has no metrics API.
+
+namespace EventMetrics
+{
+    /// @brief Current time of the clock used for the metrics, in nanoseconds.
+    inline uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /// @brief Histogram with power of two buckets, bucket i counts the samples in [2^(i-1), 2^i).
+    class LatencyHistogram
+    {
+    public:
+        static constexpr uint32_t BucketCount = 64;
+
+        /// @brief Records a sample.
+        /// @param value The sample, usually nanoseconds.
+        void Record(uint64_t value)
+        {
+            const uint32_t bucket = static_cast<uint32_t>(std::bit_width(value));
+
+            mBuckets[bucket < BucketCount ? bucket : BucketCount - 1]++;
+            mCount++;
+            mSum += value;
+            mMin = value < mMin ? value : mMin;
+            mMax = value > mMax ? value : mMax;
+        }
+
+        /// @brief Get an upper bound of the percentile, the precision is the bucket width.
+        /// @param percentile Percentile in [0, 100].
+        /// @return The upper bound of the bucket the percentile falls in, or 0 if there are no samples.
+        uint64_t Percentile(double percentile) const
+        {
+            if (mCount == 0)
+            {
+                return 0;
+            }
+
+            // Rank of the sample in [1, count].
+            uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(mCount) + 0.5);
+            rank = rank < 1 ? 1 : (rank > mCount ? mCount : rank);
+
+            uint64_t seen = 0;
+            uint32_t bucket = 0;
+
+            for (; bucket < BucketCount - 1; bucket++)
+            {
+                seen += mBuckets[bucket];
+
+                if (seen >= rank)
+                {
+                    break;
+                }
+            }
+
+            const uint64_t upper = bucket == 0 ? 0 : (uint64_t(1) << bucket) - 1;
+            return upper < mMax ? upper : mMax;
+        }
+
+        uint64_t GetCount() const { return mCount; }
+
+        uint64_t GetMin() const { return mCount ? mMin : 0; }
+
+        uint64_t GetMax() const { return mMax; }
+
+        uint64_t GetMean() const { return mCount ? mSum / mCount : 0; }
+
+        uint64_t GetBucket(uint32_t index) const { return mBuckets[index]; }
+
+    private:
+        uint64_t mBuckets[BucketCount] = {};
+
+        uint64_t mCount = 0;
+
+        uint64_t mSum = 0;
+
+        uint64_t mMin = UINT64_MAX;
+
+        uint64_t mMax = 0;
+    };
+
+    /// @brief Metrics of a single subscriber.
+    struct SubscriberMetrics
+    {
+        /// @brief Index of the subscriber in the (priority sorted) subscriber list of the event.
+        uint32_t Index = 0;
+
+        int32_t Priority = 0;
+
+        uint64_t CallCount = 0;
+
+        /// @brief Total time spent in the subscriber.
+        uint64_t TotalNanoseconds = 0;
+    };
+
+    /// @brief Metrics of a single event type.
+    struct EventTypeMetrics
+    {
+        /// @brief The underlying value of the event enum.
+        int64_t EventType = 0;
+
+        /// @brief Number of times the event was dispatched, queued or not.
+        uint64_t DispatchCount = 0;
+
+        /// @brief Number of times the event was queued, including coalesced events.
+        uint64_t QueuedCount = 0;
+
+        /// @brief Total time spent dispatching the event.
+        uint64_t DispatchNanoseconds = 0;
+
+        /// @brief Time between QueueEvent() and the dispatch of the event.
+        LatencyHistogram QueueLatency;
+
+        std::vector<SubscriberMetrics> Subscribers;
+    };
+
+    /// @brief Snapshot of the metrics of a dispatcher.
+    struct Snapshot
+    {
+        std::vector<EventTypeMetrics> Events;
+
+        /// @brief The largest number of events that were queued at once.
+        uint64_t QueueHighWaterMark = 0;
+    };
+
+    /// @brief A timed span recorded for the trace.
+    struct TraceSpan
+    {
+        int64_t EventType = 0;
+
+        /// @brief Index of the subscriber, or -1 if the span covers the whole dispatch.
+        int32_t Subscriber = -1;
+
+        uint64_t Start = 0;
+
+        uint64_t Duration = 0;
+    };
+
+    /// @brief Writes spans in the Chrome trace event format, which can be loaded in chrome://tracing or Perfetto.
+    /// @param out The stream to write to.
+    /// @param spans The recorded spans.
+    inline void WriteChromeTrace(std::ostream& out, const std::vector<TraceSpan>& spans)
+    {
+        // Timestamps are in microseconds, print them with nanosecond precision.
+        const auto writeMicroseconds = [&out](uint64_t nanoseconds) {
+            const uint64_t fraction = nanoseconds % 1000;
+
+            out << nanoseconds / 1000 << '.' << (fraction < 100 ? "0" : "") << (fraction < 10 ? "0" : "") << fraction;
+        };
+
+        out << "{\"traceEvents\":[";
+
+        for (size_t i = 0; i < spans.size(); i++)
+        {
+            const TraceSpan& span = spans[i];
+
+            out << (i ? ",\n" : "\n") << "{\"name\":\"";
+
+            if (span.Subscriber < 0)
+            {
+                out << "Dispatch " << span.EventType;
+            }
+            else
+            {
+                out << "Subscriber " << span.Subscriber;
+            }
+
+            out << "\",\"cat\":\"EventDispatcher\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":";
+            writeMicroseconds(span.Start);
+            out << ",\"dur\":";
+            writeMicroseconds(span.Duration);
+            out << ",\"args\":{\"event\":" << span.EventType << "}}";
+        }
+
+        out << "\n]}\n";
+    }
+
+} // namespace EventMetrics
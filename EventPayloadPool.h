@@ -0,0 +1,116 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/// @brief Whether EventDispatcher stores the queued payloads of T in an EventPayloadPool, so its queue only holds
+/// indices. True for payloads of 128 bytes and more, specialize it to decide for a type:
+///     template<> struct PoolEventPayload<MeshData> : std::true_type {};
+/// @tparam T Data type of the event.
+template<typename T>
+struct PoolEventPayload : std::bool_constant<(sizeof(T) >= 128)>
+{
+};
+
+/// @brief EventPayloadPool stores event payloads in recycled slots addressed by a 32 bit index. The slots are
+/// constructed when they are first used and only assigned to afterwards, so a payload with heap members (vectors,
+/// strings) keeps its capacity across events.
+/// Slots live in chunks that double in size and never move, references to payloads stay valid while the pool grows.
+/// The thread that acquires slots may be another thread than the one that reads and releases them (a double
+/// buffered producer and its consumer), as long as the indices are handed over with synchronization: Acquire() and
+/// Release() are called by the owner thread, the other thread calls ReleaseLater() and the owner takes the slots
+/// back with Recycle() at a point both threads agree on.
+/// @tparam T Data type of the event.
+template<typename T>
+class EventPayloadPool
+{
+public:
+    EventPayloadPool() = default;
+
+    EventPayloadPool(const EventPayloadPool&) = delete;
+
+    EventPayloadPool& operator=(const EventPayloadPool&) = delete;
+
+    ~EventPayloadPool()
+    {
+        for (uint32_t i = 0; i < mSlotCount; i++) { (*this)[i].~T(); }
+
+        for (uint32_t c = 0; c < MaxChunks && mChunks[c]; c++)
+        {
+            ::operator delete(mChunks[c], std::align_val_t(alignof(T)));
+        }
+    }
+
+    /// @brief Copies a payload into a free slot.
+    /// @param data The payload.
+    /// @return Index of the slot.
+    uint32_t Acquire(const T& data)
+    {
+        if (!mFreeSlots.empty())
+        {
+            const uint32_t index = mFreeSlots.back();
+            mFreeSlots.pop_back();
+
+            (*this)[index] = data;
+            return index;
+        }
+
+        const uint32_t index = mSlotCount;
+        const uint32_t chunk = GetChunk(index);
+
+        if (!mChunks[chunk])
+        {
+            mChunks[chunk] = static_cast<T*>(
+                ::operator new(sizeof(T) * (size_t(FirstChunkSize) << chunk), std::align_val_t(alignof(T))));
+        }
+
+        new (&(*this)[index]) T(data);
+        mSlotCount++;
+
+        return index;
+    }
+
+    /// @brief Get the payload in a slot.
+    T& operator[](uint32_t index)
+    {
+        const uint32_t chunk = GetChunk(index);
+        return mChunks[chunk][index - FirstChunkSize * ((1u << chunk) - 1)];
+    }
+
+    /// @brief Frees a slot for the next Acquire(). Only called by the owner thread.
+    void Release(uint32_t index) { mFreeSlots.push_back(index); }
+
+    /// @brief Frees a slot from the other thread, it can be acquired again after the next Recycle().
+    void ReleaseLater(uint32_t index) { mReleasedSlots.push_back(index); }
+
+    /// @brief Takes back the slots freed with ReleaseLater(). Neither thread may use the pool meanwhile.
+    void Recycle()
+    {
+        mFreeSlots.insert(mFreeSlots.end(), mReleasedSlots.begin(), mReleasedSlots.end());
+        mReleasedSlots.clear();
+    }
+
+    /// @brief Get the number of slots that were constructed, free or not.
+    uint32_t GetSlotCount() const { return mSlotCount; }
+
+private:
+    static constexpr uint32_t FirstChunkSize = 16;
+
+    /// @brief Enough chunks for every 32 bit index.
+    static constexpr uint32_t MaxChunks = 29;
+
+    /// @brief Chunk c holds FirstChunkSize << c slots and starts at index FirstChunkSize * (2^c - 1).
+    static uint32_t GetChunk(uint32_t index) { return std::bit_width(index / FirstChunkSize + 1) - 1; }
+
+    T* mChunks[MaxChunks] = {};
+
+    uint32_t mSlotCount = 0;
+
+    std::vector<uint32_t> mFreeSlots;
+
+    std::vector<uint32_t> mReleasedSlots;
+};
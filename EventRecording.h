@@ -0,0 +1,390 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// @brief Kind of a call recorded by an EventRecording.
+enum class EventRecordKind : uint8_t
+{
+    QueueEvent,
+    Dispatch,
+    DispatchChannel,
+    DispatchQueuedEvents,
+
+    /// @brief Keep last, kinds above it are rejected when reading a log.
+    SwapEventQueues,
+};
+
+/// @brief EventRecording is a compact binary log of the calls made to an EventDispatcher, so production event
+/// traffic can be replayed on another machine, e.g. to profile the subscribers with realistic load.
+/// Only the calls made from outside the dispatcher are recorded (QueueEvent(), Dispatch(), DispatchQueuedEvents(),
+/// SwapEventQueues()), the events subscribers queue or dispatch are produced again by the subscribers on replay.
+/// Every record is a kind byte, the time since the previous record as a varint, the event type and the raw bytes of
+/// the payload, which is why T must be trivially copyable. Loaded logs are validated record by record, a truncated or
+/// corrupt file is rejected instead of being read past its end.
+/// @tparam E Enum type of the event.
+/// @tparam T Data type of the event, must be trivially copyable.
+template<typename E, typename T>
+class EventRecording
+{
+public:
+    static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable payloads can be recorded.");
+
+    /// @brief Enum type of the event.
+    using EventEnum_t = std::underlying_type_t<E>;
+
+    /// @brief Kind of a recorded call.
+    using RecordKind = EventRecordKind;
+
+    /// @brief Replay speed.
+    enum class ReplaySpeed : uint8_t
+    {
+        /// @brief Wait between the calls like when they were recorded.
+        Original,
+
+        /// @brief Make the calls back to back, to measure throughput.
+        Maximum,
+    };
+
+    /// @brief Result of a replay.
+    struct ReplayResult
+    {
+        uint64_t RecordCount = 0;
+
+        /// @brief Wall time of the replay.
+        uint64_t Nanoseconds = 0;
+
+        /// @brief False if the replay stopped at a record it couldn't read.
+        bool Valid = true;
+    };
+
+    /// --------------------------------------------------------
+    /// Recording
+    /// --------------------------------------------------------
+
+    /// @brief Records a call without an event.
+    void Record(RecordKind kind) { WriteHeader(kind); }
+
+    /// @brief Records a call with an event.
+    void Record(RecordKind kind, E eventType, const T& data)
+    {
+        WriteHeader(kind);
+        WriteBytes(&eventType, sizeof(E));
+        WriteBytes(&data, sizeof(T));
+    }
+
+    /// @brief Records a call with an event on a channel.
+    void Record(RecordKind kind, E eventType, uint64_t key, const T& data)
+    {
+        WriteHeader(kind);
+        WriteBytes(&eventType, sizeof(E));
+        WriteVarint(key);
+        WriteBytes(&data, sizeof(T));
+    }
+
+    /// @brief Removes all the records.
+    void Clear()
+    {
+        mData.clear();
+        mRecordCount = 0;
+        mLastTime = 0;
+    }
+
+    uint64_t GetRecordCount() const { return mRecordCount; }
+
+    /// @brief Get the size of the log.
+    /// @return The size in bytes.
+    size_t GetSize() const { return mData.size(); }
+
+    /// --------------------------------------------------------
+    /// Serialization
+    /// --------------------------------------------------------
+
+    /// @brief Writes the log, with a header describing the event and payload sizes.
+    /// @param out The binary stream to write to.
+    void Save(std::ostream& out) const
+    {
+        const FileHeader header{{'U', 'E', 'V', 'R'}, Version, sizeof(E), sizeof(T), mRecordCount, mData.size()};
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(mData.data()), static_cast<std::streamsize>(mData.size()));
+    }
+
+    /// @brief Reads a log written by Save(). Every record is checked: a log that is truncated, has records of an
+    /// unknown kind or event types outside the range, or doesn't match the record count of its header is rejected.
+    /// @param in The binary stream to read from.
+    /// @param firstEventType The lowest valid event type, the default accepts every value.
+    /// @param lastEventType The highest valid event type, the default accepts every value.
+    /// @return False if the stream doesn't hold a valid log of this event and payload type, the recording is empty
+    /// then.
+    bool Load(std::istream& in, E firstEventType = static_cast<E>(std::numeric_limits<EventEnum_t>::min()),
+              E lastEventType = static_cast<E>(std::numeric_limits<EventEnum_t>::max()))
+    {
+        Clear();
+
+        FileHeader header = {};
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+        if (!in || std::memcmp(header.Magic, "UEVR", 4) != 0 || header.Version != Version ||
+            header.EventSize != sizeof(E) || header.PayloadSize != sizeof(T))
+        {
+            return false;
+        }
+
+        // Read in chunks, so a corrupt size fails at the end of the stream instead of allocating it up front.
+        constexpr uint64_t ChunkSize = 1 << 20;
+
+        while (mData.size() < header.DataSize)
+        {
+            const size_t offset = mData.size();
+            const size_t chunk = static_cast<size_t>(std::min<uint64_t>(ChunkSize, header.DataSize - offset));
+
+            mData.resize(offset + chunk);
+            in.read(reinterpret_cast<char*>(mData.data() + offset), static_cast<std::streamsize>(chunk));
+
+            if (!in)
+            {
+                Clear();
+                return false;
+            }
+        }
+
+        const EventEnum_t first = static_cast<EventEnum_t>(firstEventType);
+        const EventEnum_t last = static_cast<EventEnum_t>(lastEventType);
+
+        uint64_t recordCount = 0;
+        RecordData record;
+
+        for (size_t offset = 0; offset < mData.size(); recordCount++)
+        {
+            if (!ReadRecord(offset, record, first, last))
+            {
+                Clear();
+                return false;
+            }
+        }
+
+        if (recordCount != header.RecordCount)
+        {
+            Clear();
+            return false;
+        }
+
+        mRecordCount = recordCount;
+        return true;
+    }
+
+    /// --------------------------------------------------------
+    /// Replay
+    /// --------------------------------------------------------
+
+    /// @brief Replays the recorded calls on a dispatcher.
+    /// @tparam Dispatcher EventDispatcher<E, T>, templated so this header doesn't depend on it.
+    /// @param dispatcher The dispatcher to make the calls on.
+    /// @param speed Whether to keep the recorded timing or make the calls back to back.
+    /// @return The number of replayed records and the time it took. Not valid if a record couldn't be read, the
+    /// replay stops there. Logs that were recorded or loaded successfully are always valid.
+    template<typename Dispatcher>
+    ReplayResult Replay(Dispatcher& dispatcher, ReplaySpeed speed) const
+    {
+        using Clock = std::chrono::steady_clock;
+
+        const Clock::time_point start = Clock::now();
+        uint64_t time = 0;
+        size_t offset = 0;
+
+        ReplayResult result;
+        RecordData record;
+
+        while (offset < mData.size())
+        {
+            if (!ReadRecord(offset, record, std::numeric_limits<EventEnum_t>::min(),
+                            std::numeric_limits<EventEnum_t>::max()))
+            {
+                result.Valid = false;
+                break;
+            }
+
+            time += record.Time;
+
+            if (speed == ReplaySpeed::Original)
+            {
+                std::this_thread::sleep_until(start + std::chrono::nanoseconds(time));
+            }
+
+            switch (record.Kind)
+            {
+            case RecordKind::QueueEvent: dispatcher.QueueEvent(record.EventType, record.Data); break;
+            case RecordKind::Dispatch: dispatcher.Dispatch(record.EventType, record.Data); break;
+            case RecordKind::DispatchChannel: dispatcher.Dispatch(record.EventType, record.Key, record.Data); break;
+            case RecordKind::DispatchQueuedEvents: dispatcher.DispatchQueuedEvents(); break;
+            case RecordKind::SwapEventQueues: dispatcher.SwapEventQueues(); break;
+            }
+
+            result.RecordCount++;
+        }
+
+        result.Nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        return result;
+    }
+
+private:
+    static constexpr uint32_t Version = 1;
+
+    struct FileHeader
+    {
+        char Magic[4];
+
+        uint32_t Version;
+
+        uint32_t EventSize;
+
+        uint32_t PayloadSize;
+
+        uint64_t RecordCount;
+
+        uint64_t DataSize;
+    };
+
+    /// @brief A record read back from the log.
+    struct RecordData
+    {
+        RecordKind Kind = RecordKind::QueueEvent;
+
+        /// @brief Time since the previous record.
+        uint64_t Time = 0;
+
+        E EventType = {};
+
+        uint64_t Key = 0;
+
+        T Data;
+    };
+
+    static uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    void WriteHeader(RecordKind kind)
+    {
+        const uint64_t now = Now();
+
+        mData.push_back(static_cast<uint8_t>(kind));
+        WriteVarint(mLastTime == 0 ? 0 : now - mLastTime);
+
+        mLastTime = now;
+        mRecordCount++;
+    }
+
+    /// @brief Writes 7 bits per byte, the high bit marks that more bytes follow.
+    void WriteVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            mData.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+
+        mData.push_back(static_cast<uint8_t>(value));
+    }
+
+    void WriteBytes(const void* bytes, size_t size)
+    {
+        const uint8_t* begin = static_cast<const uint8_t*>(bytes);
+        mData.insert(mData.end(), begin, begin + size);
+    }
+
+    /// @brief Reads the record at an offset and moves the offset past it. Every read is checked against the end of
+    /// the log.
+    /// @return False if the record is truncated, has an unknown kind or an event type outside [first, last].
+    bool ReadRecord(size_t& offset, RecordData& record, EventEnum_t first, EventEnum_t last) const
+    {
+        if (offset >= mData.size() || mData[offset] > static_cast<uint8_t>(RecordKind::SwapEventQueues))
+        {
+            return false;
+        }
+
+        record.Kind = static_cast<RecordKind>(mData[offset++]);
+
+        if (!ReadVarint(offset, record.Time))
+        {
+            return false;
+        }
+
+        if (record.Kind != RecordKind::QueueEvent && record.Kind != RecordKind::Dispatch &&
+            record.Kind != RecordKind::DispatchChannel)
+        {
+            return true;
+        }
+
+        if (!ReadBytes(offset, &record.EventType, sizeof(E)))
+        {
+            return false;
+        }
+
+        const EventEnum_t type = static_cast<EventEnum_t>(record.EventType);
+
+        if (type < first || type > last)
+        {
+            return false;
+        }
+
+        if (record.Kind == RecordKind::DispatchChannel && !ReadVarint(offset, record.Key))
+        {
+            return false;
+        }
+
+        return ReadBytes(offset, &record.Data, sizeof(T));
+    }
+
+    /// @return False if the varint runs past the end of the log or is longer than 64 bits.
+    bool ReadVarint(size_t& offset, uint64_t& value) const
+    {
+        value = 0;
+
+        for (uint32_t shift = 0; shift < 64 && offset < mData.size(); shift += 7)
+        {
+            const uint8_t byte = mData[offset++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+            if ((byte & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /// @return False if there are fewer than size bytes left.
+    bool ReadBytes(size_t& offset, void* bytes, size_t size) const
+    {
+        if (size > mData.size() - offset)
+        {
+            return false;
+        }
+
+        std::memcpy(bytes, mData.data() + offset, size);
+        offset += size;
+
+        return true;
+    }
+
+    std::vector<uint8_t> mData;
+
+    uint64_t mRecordCount = 0;
+
+    /// @brief Time of the last record, the records store the time since the previous one.
+    uint64_t mLastTime = 0;
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/// @brief Open addressing hash map with linear probing. Keys and values are stored inline in a single array, so a
+/// lookup usually touches one cache line instead of chasing bucket nodes like std::unordered_map. Erasing uses
+/// backward shifting, so there are no tombstones and lookups don't degrade after many erases.
+/// Pointers to values are invalidated when the map grows or an element is erased.
+/// @tparam K Key type, must be default constructible and equality comparable.
+/// @tparam V Value type, must be default constructible and movable.
+/// @tparam H Hash of the key. The result is mixed again, so identity hashes like std::hash<uint64_t> are fine.
+template<typename K, typename V, typename H = std::hash<K>>
+class FlatHashMap
+{
+public:
+    /// @brief Finds the value of a key.
+    /// @param key The key.
+    /// @return Pointer to the value, or nullptr if the key isn't in the map.
+    V* Find(const K& key)
+    {
+        if (mSize == 0)
+        {
+            return nullptr;
+        }
+
+        for (size_t i = Home(key);; i = (i + 1) & mMask)
+        {
+            Slot& slot = mSlots[i];
+
+            if (!slot.Occupied)
+            {
+                return nullptr;
+            }
+
+            if (slot.Key == key)
+            {
+                return &slot.Value;
+            }
+        }
+    }
+
+    const V* Find(const K& key) const { return const_cast<FlatHashMap*>(this)->Find(key); }
+
+    /// @brief Finds the value of a key, or inserts a default constructed value if the key isn't in the map.
+    /// @param key The key.
+    /// @return Reference to the value.
+    V& operator[](const K& key)
+    {
+        // Keep the load factor at or below 3/4 so probe sequences stay short.
+        if ((mSize + 1) * 4 > mSlots.size() * 3)
+        {
+            Rehash(mSlots.empty() ? 16 : mSlots.size() * 2);
+        }
+
+        size_t i = Home(key);
+
+        for (; mSlots[i].Occupied; i = (i + 1) & mMask)
+        {
+            if (mSlots[i].Key == key)
+            {
+                return mSlots[i].Value;
+            }
+        }
+
+        mSlots[i].Occupied = true;
+        mSlots[i].Key = key;
+        mSize++;
+
+        return mSlots[i].Value;
+    }
+
+    /// @brief Erases a key from the map.
+    /// @param key The key.
+    /// @return True if the key was in the map.
+    bool Erase(const K& key)
+    {
+        if (mSize == 0)
+        {
+            return false;
+        }
+
+        size_t i = Home(key);
+
+        for (; mSlots[i].Key != key || !mSlots[i].Occupied; i = (i + 1) & mMask)
+        {
+            if (!mSlots[i].Occupied)
+            {
+                return false;
+            }
+        }
+
+        // Shift the following elements of the probe sequence back, so no element becomes unreachable.
+        for (size_t j = (i + 1) & mMask; mSlots[j].Occupied; j = (j + 1) & mMask)
+        {
+            const size_t home = Home(mSlots[j].Key);
+
+            // Move the element if the hole lies between its home slot and its current slot (cyclically).
+            if (((j - home) & mMask) >= ((j - i) & mMask))
+            {
+                mSlots[i].Key = std::move(mSlots[j].Key);
+                mSlots[i].Value = std::move(mSlots[j].Value);
+                i = j;
+            }
+        }
+
+        mSlots[i] = Slot();
+        mSize--;
+
+        return true;
+    }
+
+    /// @brief Calls fn(key, value) for every element, in no particular order.
+    template<typename Fn>
+    void ForEach(Fn&& fn)
+    {
+        for (Slot& slot : mSlots)
+        {
+            if (slot.Occupied)
+            {
+                fn(static_cast<const K&>(slot.Key), slot.Value);
+            }
+        }
+    }
+
+    /// @brief Removes all the elements, the capacity is kept.
+    void Clear()
+    {
+        if (mSize == 0)
+        {
+            return;
+        }
+
+        for (Slot& slot : mSlots) { slot = Slot(); }
+        mSize = 0;
+    }
+
+    size_t Size() const { return mSize; }
+
+    bool Empty() const { return mSize == 0; }
+
+private:
+    struct Slot
+    {
+        K Key = K();
+
+        V Value = V();
+
+        bool Occupied = false;
+    };
+
+    /// @brief Home slot of a key. The hash is mixed with a Fibonacci multiplication so that sequential keys and
+    /// hashes with empty low bits still spread over the table.
+    size_t Home(const K& key) const
+    {
+        const uint64_t hash = static_cast<uint64_t>(H()(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(hash >> 32) & mMask;
+    }
+
+    void Rehash(size_t capacity)
+    {
+        std::vector<Slot> old = std::move(mSlots);
+
+        mSlots.clear();
+        mSlots.resize(capacity);
+        mMask = capacity - 1;
+
+        for (Slot& slot : old)
+        {
+            if (!slot.Occupied)
+            {
+                continue;
+            }
+
+            size_t i = Home(slot.Key);
+            while (mSlots[i].Occupied) { i = (i + 1) & mMask; }
+
+            mSlots[i] = std::move(slot);
+        }
+    }
+
+    std::vector<Slot> mSlots;
+
+    size_t mMask = 0;
+
+    size_t mSize = 0;
+};
@@ -5,7 +5,9 @@
 #include "SharedPointer.h"
 
 // Add pragma to disable casting pointer to function to another pointer to function
+#ifdef _MSC_VER
 #pragma pointers_to_members(full_generality, virtual_inheritance)
+#endif
 
 // Code below is based on
 // https://codereview.stackexchange.com/questions/277865/tfunction-stdfunction-replacement-for-event-system
@@ -39,7 +41,7 @@ public:
     /// @param instance pointer to the instance of the class.
     template<typename C>
     Function(C* instance, FunctionPtrMember<C> function)
-        : mMemberFunction(reinterpret_cast<FunctionPtrMember<Instance>>(function)),
+        : mMemberFunction(reinterpret_cast<FunctionPtrMember<Instance>>(function)), mFunction(nullptr),
           mInstance(reinterpret_cast<Instance*>(instance))
     {
     }
@@ -52,7 +54,7 @@ public:
     /// @param function The member function to bind.
     template<typename C>
     Function(const SharedPointer<C>& instance, FunctionPtrMember<C> function)
-        : mMemberFunction(reinterpret_cast<FunctionPtrMember<Instance>>(function)),
+        : mMemberFunction(reinterpret_cast<FunctionPtrMember<Instance>>(function)), mFunction(nullptr),
           mInstance(reinterpret_cast<Instance*>(instance.get()))
     {
     }
@@ -121,6 +123,19 @@ public:
         return mFunction != nullptr && mInstance != nullptr;
     }
 
+    /// @brief Checks if two functions are bound to the same target.
+    /// @param other The other function.
+    /// @return True if both are bound to the same static function, or the same member function of the same instance.
+    constexpr bool operator==(const Function& other) const
+    {
+        if (mInstance != other.mInstance)
+        {
+            return false;
+        }
+
+        return mInstance ? mMemberFunction == other.mMemberFunction : mFunction == other.mFunction;
+    }
+
 private:
     struct Instance; // Dummy struct to allow member functions to be invoked
 
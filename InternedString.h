@@ -0,0 +1,341 @@
+#pragma once
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Strings.h"
+
+/// @brief InternedString is an atom: every distinct string is stored once in a global intern table, and an
+/// InternedString is the 32 bit id of its entry. Comparing two interned strings compares the ids, and the hash is
+/// computed once when the string is interned, so they are cheap keys for hash maps with many lookups.
+/// Interning looks the string up in the table, which is split into shards with their own lock, so threads interning
+/// different strings rarely wait for each other. c_str(), size() and Hash() don't lock.
+/// Interned strings are never freed, the characters stay at the same address for the lifetime of the program. Only
+/// intern strings from a bounded set (identifiers, names, keys), not arbitrary input.
+class InternedString
+{
+public:
+    /// @brief Default constructor, the empty string.
+    InternedString() = default;
+
+    /// @brief Interns a string, or finds it if it's interned already. Can be called from any thread.
+    /// @param str String.
+    explicit InternedString(std::string_view str) : mId(GetTable().Intern(str, true)) {}
+
+    /// @brief Interns a string, or finds it if it's interned already. Can be called from any thread.
+    /// @param str String.
+    explicit InternedString(const std::string& str) : InternedString(std::string_view(str)) {}
+
+    /// @brief Interns a string, or finds it if it's interned already. Can be called from any thread.
+    /// @param str String.
+    explicit InternedString(const NarrowString& str) : InternedString(std::string_view(str.data(), str.size())) {}
+
+    /// @brief Interns a string, or finds it if it's interned already. Can be called from any thread.
+    /// @param str Null terminated string.
+    explicit InternedString(const char* str) : InternedString(std::string_view(str)) {}
+
+    /// @brief Finds a string without interning it, e.g. to look up untrusted input. Can be called from any thread.
+    /// @param str String.
+    /// @param result Set to the interned string if it was found.
+    /// @return True if the string is interned.
+    static bool Find(std::string_view str, InternedString& result)
+    {
+        const uint32_t id = GetTable().Intern(str, false);
+
+        if (id == 0 && !str.empty())
+        {
+            return false;
+        }
+
+        result.mId = id;
+        return true;
+    }
+
+    /// @brief Equality operator, compares the ids.
+    /// @param other Other string.
+    bool operator==(const InternedString& other) const { return mId == other.mId; }
+
+    /// @brief Conversion to string view, the characters stay valid for the lifetime of the program.
+    operator std::string_view() const
+    {
+        const Table::Entry& entry = GetTable().Get(mId);
+        return std::string_view(entry.Data, entry.Size);
+    }
+
+    /// @brief Get the id of the string, unique for the lifetime of the program but not across runs.
+    /// @return Id of the string, 0 for the empty string.
+    uint32_t Id() const { return mId; }
+
+    /// @brief Get the hash computed when the string was interned, the same as std::hash<NarrowString>.
+    /// @return Hash of the string.
+    size_t Hash() const { return GetTable().Get(mId).Hash; }
+
+    /// ---------------------
+    /// STL string operations
+    /// ---------------------
+
+    /// @brief Get the size of the string.
+    /// @return Size of the string.
+    uint32_t size() const { return GetTable().Get(mId).Size; }
+
+    /// @brief Get the string.
+    /// @return Null terminated string.
+    const char* c_str() const { return GetTable().Get(mId).Data; }
+
+    /// @brief Get the string.
+    /// @return Null terminated string.
+    const char* data() const { return c_str(); }
+
+private:
+    /// @brief The intern table. A string is assigned to a shard by its hash, the shard finds it with linear probing
+    /// over the ids of its strings. The entries are allocated in chunks that double in size and never move, so they
+    /// are read without locking: an id is only known after the shard lock that created its entry was released.
+    class Table
+    {
+    public:
+        struct Entry
+        {
+            const char* Data;
+
+            size_t Hash;
+
+            uint32_t Size;
+        };
+
+        Table()
+        {
+            // Entry 0 of shard 0 is the empty string, which is never looked up in the shards.
+            mChunks[0][0] = std::make_unique<Entry[]>(FirstChunkSize);
+            mChunks[0][0][0] = Entry{"", std::hash<std::string_view>()(std::string_view()), 0};
+            mShards[0].Count = 1;
+        }
+
+        /// @brief Finds a string, and interns it if it isn't found and insert is true.
+        /// @return Id of the string, 0 for the empty string or if it wasn't found.
+        uint32_t Intern(std::string_view str, bool insert)
+        {
+            if (str.empty())
+            {
+                return 0;
+            }
+
+            assert(str.size() < UINT32_MAX);
+
+            const size_t hash = std::hash<std::string_view>()(str);
+            const uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+            const uint32_t shardIndex = static_cast<uint32_t>(mixed >> (64 - ShardBits));
+            const uint32_t tag = static_cast<uint32_t>(hash);
+
+            Shard& shard = mShards[shardIndex];
+            const std::lock_guard<std::mutex> lock(shard.Mutex);
+
+            size_t i = static_cast<size_t>(mixed >> 32) & shard.Mask;
+
+            for (; !shard.Slots.empty() && shard.Slots[i].Id != 0; i = (i + 1) & shard.Mask)
+            {
+                const Slot slot = shard.Slots[i];
+
+                if (slot.Tag != tag)
+                {
+                    continue;
+                }
+
+                const Entry& entry = Get(slot.Id);
+
+                if (entry.Size == str.size() && std::memcmp(entry.Data, str.data(), str.size()) == 0)
+                {
+                    return slot.Id;
+                }
+            }
+
+            if (!insert)
+            {
+                return 0;
+            }
+
+            // Keep the load factor at or below 3/4 so probe sequences stay short.
+            if ((shard.Occupied + 1) * 4 > shard.Slots.size() * 3)
+            {
+                Rehash(shard, shard.Slots.empty() ? 16 : shard.Slots.size() * 2);
+
+                i = static_cast<size_t>(mixed >> 32) & shard.Mask;
+                while (shard.Slots[i].Id != 0) { i = (i + 1) & shard.Mask; }
+            }
+
+            const uint32_t index = shard.Count++;
+            assert(index < (1u << (32 - ShardBits)) && "Too many interned strings");
+
+            const uint32_t id = (index << ShardBits) | shardIndex;
+            const uint32_t chunk = ChunkOf(index);
+
+            if (!mChunks[shardIndex][chunk])
+            {
+                mChunks[shardIndex][chunk] = std::make_unique<Entry[]>(FirstChunkSize << chunk);
+            }
+
+            mChunks[shardIndex][chunk][OffsetOf(index, chunk)] =
+                Entry{Store(shard, str), hash, static_cast<uint32_t>(str.size())};
+
+            shard.Slots[i] = Slot{tag, id};
+            shard.Occupied++;
+
+            return id;
+        }
+
+        const Entry& Get(uint32_t id) const
+        {
+            const uint32_t index = id >> ShardBits;
+            const uint32_t chunk = ChunkOf(index);
+
+            return mChunks[id & (ShardCount - 1)][chunk][OffsetOf(index, chunk)];
+        }
+
+    private:
+        static constexpr uint32_t ShardBits = 6;
+
+        static constexpr uint32_t ShardCount = 1u << ShardBits;
+
+        static constexpr uint32_t FirstChunkBits = 6;
+
+        static constexpr uint32_t FirstChunkSize = 1u << FirstChunkBits;
+
+        /// @brief Chunks for the 2^(32 - ShardBits) entries a shard can have.
+        static constexpr uint32_t ChunkCount = 32 - ShardBits - FirstChunkBits + 1;
+
+        /// @brief Characters are copied into blocks of this size, longer strings get an allocation of their own.
+        static constexpr size_t BlockSize = 16384;
+
+        /// @brief A slot of the probing table, Id 0 is an empty slot. The tag holds low bits of the hash, so most
+        /// mismatches are rejected without reading the entry.
+        struct Slot
+        {
+            uint32_t Tag;
+
+            uint32_t Id;
+        };
+
+        /// @brief A shard is aligned to a cache line, so threads interning in neighbouring shards don't false share.
+        struct alignas(64) Shard
+        {
+            std::mutex Mutex;
+
+            std::vector<Slot> Slots;
+
+            size_t Mask = 0;
+
+            /// @brief Number of occupied slots.
+            size_t Occupied = 0;
+
+            /// @brief Number of entries.
+            uint32_t Count = 0;
+
+            std::vector<std::unique_ptr<char[]>> Blocks;
+
+            char* Cursor = nullptr;
+
+            size_t Remaining = 0;
+        };
+
+        static uint32_t ChunkOf(uint32_t index)
+        {
+            return static_cast<uint32_t>(std::bit_width(index + FirstChunkSize)) - 1 - FirstChunkBits;
+        }
+
+        static uint32_t OffsetOf(uint32_t index, uint32_t chunk)
+        {
+            return index + FirstChunkSize - (FirstChunkSize << chunk);
+        }
+
+        void Rehash(Shard& shard, size_t capacity)
+        {
+            std::vector<Slot> old = std::move(shard.Slots);
+
+            shard.Slots.assign(capacity, Slot{0, 0});
+            shard.Mask = capacity - 1;
+
+            for (const Slot& slot : old)
+            {
+                if (slot.Id == 0)
+                {
+                    continue;
+                }
+
+                const uint64_t mixed = static_cast<uint64_t>(Get(slot.Id).Hash) * 0x9E3779B97F4A7C15ull;
+
+                size_t i = static_cast<size_t>(mixed >> 32) & shard.Mask;
+                while (shard.Slots[i].Id != 0) { i = (i + 1) & shard.Mask; }
+
+                shard.Slots[i] = slot;
+            }
+        }
+
+        /// @brief Copies the characters of a string and a null terminator into the blocks of a shard.
+        static const char* Store(Shard& shard, std::string_view str)
+        {
+            const size_t size = str.size() + 1;
+            char* data;
+
+            if (size > BlockSize / 4)
+            {
+                shard.Blocks.push_back(std::make_unique<char[]>(size));
+                data = shard.Blocks.back().get();
+            }
+            else
+            {
+                if (size > shard.Remaining)
+                {
+                    shard.Blocks.push_back(std::make_unique<char[]>(BlockSize));
+                    shard.Cursor = shard.Blocks.back().get();
+                    shard.Remaining = BlockSize;
+                }
+
+                data = shard.Cursor;
+                shard.Cursor += size;
+                shard.Remaining -= size;
+            }
+
+            std::memcpy(data, str.data(), str.size());
+            data[str.size()] = '\0';
+
+            return data;
+        }
+
+        Shard mShards[ShardCount];
+
+        /// @brief Entry chunks of every shard, apart from the shards so reading an entry doesn't touch the cache
+        /// lines of their locks.
+        std::unique_ptr<Entry[]> mChunks[ShardCount][ChunkCount];
+    };
+
+    /// @brief The global table. It's never destroyed, so strings interned by static objects stay valid while the
+    /// program exits.
+    static Table& GetTable()
+    {
+        static Table* table = new Table();
+        return *table;
+    }
+
+    uint32_t mId = 0;
+};
+
+static_assert(sizeof(InternedString) == 4);
+
+namespace std
+{
+    /// @brief The hash computed when the string was interned.
+    template<>
+    struct hash<InternedString>
+    {
+        size_t operator()(const InternedString& str) const { return str.Hash(); }
+    };
+
+} // namespace std
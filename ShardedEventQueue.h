@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// @brief ShardedEventQueue is an event queue for many producer threads. Instead of one queue every producer
+/// thread pushes to, each thread is assigned one of several shards, so producers on different shards never touch the
+/// same lock or cache line. DispatchQueuedEvents() collects the shards and dispatches their events on a dispatcher.
+/// A thread always queues to the same shard, so the events of a producer are dispatched in the order it queued them.
+/// The order between producers is the shard order by default, with MergeOrder::Timestamp the shards are merged by
+/// the time the events were queued instead, at the cost of a clock read per event.
+/// Any number of threads can queue, one thread dispatches. Events queued while dispatching (e.g. by subscribers)
+/// are dispatched by the next DispatchQueuedEvents().
+/// The shards are not lock-free: each one is a vector behind a mutex, sharding only spreads the producers over many
+/// locks. A thread gets its shard from a global counter that is bumped once per thread and taken modulo the shard
+/// count, and indices are never reused. With short-lived threads (e.g. a pool that keeps spawning workers) the live
+/// threads can end up on the same shards while others stay empty, so prefer long-lived producer threads.
+/// @tparam E Enum type of the event. IT MUST BE AN ENUM CLASS.
+/// @tparam T Data type of the event.
+template<typename E, typename T>
+class ShardedEventQueue
+{
+public:
+    /// @brief Order of the events of different producers.
+    enum class MergeOrder : uint8_t
+    {
+        /// @brief Shard by shard, the events of each producer stay in order.
+        PerProducer,
+
+        /// @brief By the time they were queued, across all the shards.
+        Timestamp,
+    };
+
+    /// @brief Creates the shards.
+    /// @param shardCount Number of shards, 0 for one per hardware thread. Threads beyond the shard count share
+    /// shards.
+    /// @param order Order of the events of different producers.
+    explicit ShardedEventQueue(uint32_t shardCount = 0, MergeOrder order = MergeOrder::PerProducer)
+        : mShardCount(shardCount != 0 ? shardCount : std::max(1u, std::thread::hardware_concurrency())),
+          mShards(std::make_unique<Shard[]>(mShardCount)), mOrder(order)
+    {
+    }
+
+    ShardedEventQueue(const ShardedEventQueue&) = delete;
+
+    ShardedEventQueue& operator=(const ShardedEventQueue&) = delete;
+
+    /// @brief Queues an event on the shard of the calling thread. Can be called from any thread.
+    /// @param eventType The type of the event.
+    /// @param data The data to be passed to the subscribers, copied into the shard.
+    void QueueEvent(E eventType, const T& data)
+    {
+        Shard& shard = mShards[GetThreadIndex() % mShardCount];
+
+        const std::lock_guard<std::mutex> lock(shard.Mutex);
+
+        // Read under the lock, so the timestamps within a shard never decrease and the shards can be merged.
+        const uint64_t timestamp = mOrder == MergeOrder::Timestamp ? Now() : 0;
+
+        shard.Queue.push_back({eventType, data, timestamp});
+    }
+
+    /// @brief Dispatches the queued events of all the shards. Only one thread may call it at a time.
+    /// @tparam Dispatcher EventDispatcher<E, T>, or anything with Dispatch(E, T&).
+    /// @param dispatcher The dispatcher to dispatch the events with.
+    /// @return The number of dispatched events.
+    template<typename Dispatcher>
+    size_t DispatchQueuedEvents(Dispatcher& dispatcher)
+    {
+        // Swap every shard with its drain buffer, the producers only wait for the swap of their own shard.
+        for (uint32_t i = 0; i < mShardCount; i++)
+        {
+            Shard& shard = mShards[i];
+
+            const std::lock_guard<std::mutex> lock(shard.Mutex);
+            shard.Queue.swap(shard.Drain);
+        }
+
+        const size_t count =
+            mOrder == MergeOrder::Timestamp ? DispatchByTimestamp(dispatcher) : DispatchByShard(dispatcher);
+
+        for (uint32_t i = 0; i < mShardCount; i++)
+        {
+            mShards[i].Drain.clear(); // Keeps the capacity, so queueing doesn't allocate once the shards have grown.
+        }
+
+        return count;
+    }
+
+    uint32_t GetShardCount() const { return mShardCount; }
+
+private:
+    struct QueuedEvent
+    {
+        E Type;
+
+        T Data;
+
+        uint64_t Timestamp;
+    };
+
+    /// @brief A shard is aligned to a cache line, so producers on neighbouring shards don't false share.
+    struct alignas(64) Shard
+    {
+        std::mutex Mutex;
+
+        /// @brief Events queued by the producers.
+        std::vector<QueuedEvent> Queue;
+
+        /// @brief Events being dispatched, only touched by the dispatching thread.
+        std::vector<QueuedEvent> Drain;
+    };
+
+    /// @brief Next event of a shard in the timestamp merge.
+    struct MergeHead
+    {
+        uint64_t Timestamp;
+
+        uint32_t Shard;
+
+        uint32_t Index;
+    };
+
+    static uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /// @brief Index of the calling thread, assigned on its first event. Shared by all the queues, so a thread
+    /// producing to several queues uses the same shard index in each of them.
+    static uint32_t GetThreadIndex()
+    {
+        static std::atomic<uint32_t> nextIndex = 0;
+        static thread_local const uint32_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+
+        return index;
+    }
+
+    template<typename Dispatcher>
+    size_t DispatchByShard(Dispatcher& dispatcher)
+    {
+        size_t count = 0;
+
+        for (uint32_t i = 0; i < mShardCount; i++)
+        {
+            for (QueuedEvent& event : mShards[i].Drain)
+            {
+                dispatcher.Dispatch(event.Type, event.Data);
+            }
+
+            count += mShards[i].Drain.size();
+        }
+
+        return count;
+    }
+
+    /// @brief K-way merge of the shards, each of them is sorted by timestamp already. The heap holds the next event
+    /// of every shard that isn't exhausted.
+    template<typename Dispatcher>
+    size_t DispatchByTimestamp(Dispatcher& dispatcher)
+    {
+        // Earliest timestamp on top, ties in shard order.
+        const auto later = [](const MergeHead& a, const MergeHead& b) {
+            return a.Timestamp != b.Timestamp ? a.Timestamp > b.Timestamp : a.Shard > b.Shard;
+        };
+
+        mHeads.clear();
+
+        for (uint32_t i = 0; i < mShardCount; i++)
+        {
+            if (!mShards[i].Drain.empty())
+            {
+                mHeads.push_back({mShards[i].Drain.front().Timestamp, i, 0});
+            }
+        }
+
+        std::make_heap(mHeads.begin(), mHeads.end(), later);
+
+        size_t count = 0;
+
+        while (!mHeads.empty())
+        {
+            std::pop_heap(mHeads.begin(), mHeads.end(), later);
+            MergeHead& head = mHeads.back();
+
+            std::vector<QueuedEvent>& drain = mShards[head.Shard].Drain;
+            QueuedEvent& event = drain[head.Index];
+
+            dispatcher.Dispatch(event.Type, event.Data);
+            count++;
+
+            if (++head.Index < drain.size())
+            {
+                head.Timestamp = drain[head.Index].Timestamp;
+                std::push_heap(mHeads.begin(), mHeads.end(), later);
+            }
+            else
+            {
+                mHeads.pop_back();
+            }
+        }
+
+        return count;
+    }
+
+    const uint32_t mShardCount;
+
+    std::unique_ptr<Shard[]> mShards;
+
+    const MergeOrder mOrder;
+
+    /// @brief Merge heap, kept to reuse its memory.
+    std::vector<MergeHead> mHeads;
+};
@@ -0,0 +1,380 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/// @brief SharedMemoryEventQueue is an event queue in POSIX shared memory, so a process can queue events that
+/// another process on the same host dispatches, without serialization or sockets. One process creates the queue
+/// with Create(), the others open it by name with Open().
+/// The queue is a bounded ring (Dmitry Vyukov's MPMC queue), any number of processes/threads can queue and
+/// dispatch. A consumer with nothing to do sleeps in WaitForEvents() on a futex, producers only make the wake up
+/// system call when a consumer is actually sleeping.
+/// Only available on Linux.
+/// @tparam E Enum type of the event. IT MUST BE AN ENUM CLASS.
+/// @tparam T Data type of the event, must be trivially copyable since it's copied between address spaces.
+template<typename E, typename T>
+class SharedMemoryEventQueue
+{
+public:
+    static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable payloads can be shared between processes.");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory atomics must be lock-free.");
+
+    SharedMemoryEventQueue() = default;
+
+    SharedMemoryEventQueue(const SharedMemoryEventQueue&) = delete;
+
+    SharedMemoryEventQueue& operator=(const SharedMemoryEventQueue&) = delete;
+
+    /// @brief Unmaps the queue, the creator also removes its name. Processes that still have it open keep using it.
+    ~SharedMemoryEventQueue() { Close(); }
+
+    /// @brief Creates the shared memory and the queue in it.
+    /// @param name Name of the shared memory object, e.g. "/game-events".
+    /// @param capacity Number of events the queue can hold, rounded up to a power of two, at most 2^31.
+    /// @param replace Whether to remove an existing shared memory object with the same name, e.g. one left behind by
+    /// a crashed process. Processes that have it open keep using the old queue.
+    /// @return False if the name exists and replace is false, the capacity is too large or the shared memory couldn't
+    /// be created or mapped.
+    bool Create(const char* name, uint32_t capacity, bool replace = false)
+    {
+        Close();
+
+        if (capacity > MaxCapacity)
+        {
+            return false;
+        }
+
+        const uint32_t roundedCapacity = std::bit_ceil(capacity);
+
+        if (replace)
+        {
+            shm_unlink(name);
+        }
+
+        const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        const size_t size = sizeof(Header) + sizeof(Cell) * roundedCapacity;
+
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0 || !Map(fd, size))
+        {
+            close(fd);
+            shm_unlink(name);
+            return false;
+        }
+
+        close(fd);
+
+        // The memory is zeroed by ftruncate, construct the atomics and publish the header last.
+        mHeader = new (mHeader) Header();
+        mHeader->PayloadSize = sizeof(T);
+        mHeader->Capacity = roundedCapacity;
+        mCells = reinterpret_cast<Cell*>(mHeader + 1);
+
+        for (uint32_t i = 0; i < roundedCapacity; i++)
+        {
+            new (&mCells[i].Sequence) std::atomic<uint64_t>(i);
+        }
+
+        mHeader->Magic.store(Magic, std::memory_order_release);
+
+        mName = name;
+        mOwner = true;
+        return true;
+    }
+
+    /// @brief Opens a queue created by another process.
+    /// @param name Name of the shared memory object.
+    /// @return False if it doesn't exist (yet), holds a queue of another payload type or its header is corrupt.
+    bool Open(const char* name)
+    {
+        Close();
+
+        const int fd = shm_open(name, O_RDWR, 0600);
+
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat info = {};
+
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header) ||
+            !Map(fd, static_cast<size_t>(info.st_size)))
+        {
+            close(fd);
+            return false;
+        }
+
+        close(fd);
+
+        if (mHeader->Magic.load(std::memory_order_acquire) != Magic || mHeader->PayloadSize != sizeof(T) ||
+            !IsValidCapacity(mHeader->Capacity) || sizeof(Header) + sizeof(Cell) * mHeader->Capacity > mSize)
+        {
+            Close();
+            return false;
+        }
+
+        mCells = reinterpret_cast<Cell*>(mHeader + 1);
+        return true;
+    }
+
+    /// @brief Unmaps the queue.
+    void Close()
+    {
+        if (mHeader)
+        {
+            munmap(mHeader, mSize);
+        }
+
+        if (mOwner)
+        {
+            shm_unlink(mName.c_str());
+        }
+
+        mHeader = nullptr;
+        mCells = nullptr;
+        mSize = 0;
+        mOwner = false;
+    }
+
+    bool IsOpen() const { return mHeader != nullptr; }
+
+    /// @brief Queues an event for another process. Never blocks.
+    /// @param eventType The type of the event.
+    /// @param data The data, copied into the shared memory.
+    /// @return False if the queue is full.
+    bool QueueEvent(E eventType, const T& data)
+    {
+        uint64_t position = mHeader->EnqueuePosition.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        while (true)
+        {
+            cell = &mCells[position & (mHeader->Capacity - 1)];
+            const uint64_t sequence = cell->Sequence.load(std::memory_order_acquire);
+            const int64_t difference = static_cast<int64_t>(sequence - position);
+
+            if (difference == 0)
+            {
+                if (mHeader->EnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false; // The cell still holds an event from the previous lap, the queue is full.
+            }
+            else
+            {
+                position = mHeader->EnqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->Type = eventType;
+        std::memcpy(&cell->Data, &data, sizeof(T));
+        cell->Sequence.store(position + 1, std::memory_order_release);
+
+        // Pairs with the sequentially consistent increment of the waiter count in WaitForEvents(): either the
+        // consumer sees the event before sleeping, or this sees the waiter and wakes it.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (mHeader->Waiters.load(std::memory_order_relaxed) != 0)
+        {
+            mHeader->WakeCount.fetch_add(1, std::memory_order_release);
+            Futex(FUTEX_WAKE, INT_MAX, nullptr);
+        }
+
+        return true;
+    }
+
+    /// @brief Pops the oldest event.
+    /// @param eventType Set to the type of the event.
+    /// @param data Set to the data of the event.
+    /// @return False if the queue is empty.
+    bool TryPopEvent(E& eventType, T& data)
+    {
+        uint64_t position = mHeader->DequeuePosition.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        while (true)
+        {
+            cell = &mCells[position & (mHeader->Capacity - 1)];
+            const uint64_t sequence = cell->Sequence.load(std::memory_order_acquire);
+            const int64_t difference = static_cast<int64_t>(sequence - (position + 1));
+
+            if (difference == 0)
+            {
+                if (mHeader->DequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false; // Empty.
+            }
+            else
+            {
+                position = mHeader->DequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        eventType = cell->Type;
+        std::memcpy(&data, &cell->Data, sizeof(T));
+        cell->Sequence.store(position + mHeader->Capacity, std::memory_order_release);
+
+        return true;
+    }
+
+    /// @brief Dispatches all the events in the queue on a dispatcher of this process.
+    /// @tparam Dispatcher EventDispatcher<E, T>.
+    /// @param dispatcher The dispatcher to dispatch the events with.
+    /// @return The number of dispatched events.
+    template<typename Dispatcher>
+    size_t DispatchQueuedEvents(Dispatcher& dispatcher)
+    {
+        size_t count = 0;
+        E eventType;
+        T data;
+
+        while (TryPopEvent(eventType, data))
+        {
+            dispatcher.Dispatch(eventType, data);
+            count++;
+        }
+
+        return count;
+    }
+
+    /// @brief Sleeps until an event is queued or the timeout expires. Returns immediately if the queue isn't empty.
+    /// @param timeout The maximum time to wait.
+    /// @return True if the queue has events.
+    bool WaitForEvents(std::chrono::nanoseconds timeout)
+    {
+        mHeader->Waiters.fetch_add(1, std::memory_order_seq_cst);
+
+        const uint32_t wakeCount = mHeader->WakeCount.load(std::memory_order_acquire);
+
+        if (IsEmpty())
+        {
+            timespec time = {};
+            time.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+            time.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+
+            // Returns right away if a producer bumped the wake count since it was read.
+            Futex(FUTEX_WAIT, wakeCount, &time);
+        }
+
+        mHeader->Waiters.fetch_sub(1, std::memory_order_relaxed);
+
+        return !IsEmpty();
+    }
+
+    /// @brief Checks if the queue is empty, may be outdated as soon as it returns.
+    bool IsEmpty() const
+    {
+        const uint64_t position = mHeader->DequeuePosition.load(std::memory_order_acquire);
+        const Cell& cell = mCells[position & (mHeader->Capacity - 1)];
+
+        return cell.Sequence.load(std::memory_order_acquire) != position + 1;
+    }
+
+private:
+    static constexpr uint32_t Magic = 0x55455151; // "UEQQ"
+
+    /// @brief The largest power of two a uint32_t capacity can be rounded up to.
+    static constexpr uint32_t MaxCapacity = 1u << 31;
+
+    /// @brief Checks a capacity read from the shared memory, every position is masked with it.
+    static constexpr bool IsValidCapacity(uint32_t capacity)
+    {
+        return capacity != 0 && std::has_single_bit(capacity) && capacity <= MaxCapacity;
+    }
+
+    /// @brief Header at the start of the shared memory, the positions are on their own cache lines so producers
+    /// and consumers don't invalidate each others lines.
+    struct Header
+    {
+        std::atomic<uint32_t> Magic = 0;
+
+        uint32_t PayloadSize = 0;
+
+        uint32_t Capacity = 0;
+
+        alignas(64) std::atomic<uint64_t> EnqueuePosition = 0;
+
+        alignas(64) std::atomic<uint64_t> DequeuePosition = 0;
+
+        /// @brief Futex word, bumped by producers before waking the consumers.
+        alignas(64) std::atomic<uint32_t> WakeCount = 0;
+
+        /// @brief Number of consumers in WaitForEvents().
+        std::atomic<uint32_t> Waiters = 0;
+    };
+
+    struct Cell
+    {
+        std::atomic<uint64_t> Sequence;
+
+        E Type;
+
+        T Data;
+    };
+
+    bool Map(int fd, size_t size)
+    {
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (memory == MAP_FAILED)
+        {
+            return false;
+        }
+
+        mHeader = static_cast<Header*>(memory);
+        mSize = size;
+        return true;
+    }
+
+    /// @brief Futex system call on the wake count, not private since the word is shared between processes.
+    long Futex(int operation, uint32_t value, const timespec* timeout)
+    {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&mHeader->WakeCount), operation, value, timeout,
+                       nullptr, 0);
+    }
+
+    Header* mHeader = nullptr;
+
+    Cell* mCells = nullptr;
+
+    size_t mSize = 0;
+
+    std::string mName;
+
+    /// @brief Whether this process created the queue and removes its name when closing it.
+    bool mOwner = false;
+};
+
+#endif
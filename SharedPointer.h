@@ -1,9 +1,20 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <type_traits>
 #include <utility>
 
+/// @brief Offset of the object from the reference count. The same for every type so the casts keep the layout, and
+/// large enough that objects of any fundamental alignment are aligned in the new[] allocation.
+/// The allocation holds the reference count, the weak reference count and the object: [uint32][uint32]...[T].
+inline constexpr size_t SharedPointerDataOffset = alignof(std::max_align_t);
+
+static_assert(SharedPointerDataOffset >= 2 * sizeof(uint32_t));
+
+template<typename T>
+class WeakPointer;
+
 template<typename T>
 class SharedPointer
 {
@@ -23,7 +34,7 @@ public:
         : mData(reinterpret_cast<uint8_t*>(data))
 #ifndef NDEBUG // In debug mode store the object pointer as well.
           ,
-          mObject(reinterpret_cast<T*>(data + sizeof(uint32_t)))
+          mObject(reinterpret_cast<T*>(data + SharedPointerDataOffset))
 #endif
     {
     }
@@ -192,7 +203,7 @@ public:
     }
 
 private:
-    inline T* GetData() const { return reinterpret_cast<T*>(mData + sizeof(uint32_t)); }
+    inline T* GetData() const { return reinterpret_cast<T*>(mData + SharedPointerDataOffset); }
 
     inline uint32_t* GetReferenceData() const { return reinterpret_cast<uint32_t*>(mData); }
 
@@ -208,20 +219,34 @@ private:
 
     inline void RemoveReference()
     {
-        uint32_t& referenceCount = *GetReferenceData();
-
         if (mData == nullptr)
             return;
 
+        uint32_t& referenceCount = *GetReferenceData();
+
         referenceCount--;
 
         if (referenceCount == 0)
         {
             GetData()->~T(); // Call the destructor of the data.
-            delete[] mData; // Delete the data.
+
+            // The shared pointers hold one weak reference together, the memory is deleted with the last weak one.
+            uint32_t& weakReferenceCount = *GetWeakReferenceData();
+
+            weakReferenceCount--;
+
+            if (weakReferenceCount == 0)
+            {
+                delete[] mData; // Delete the data.
+            }
         }
     }
 
+    inline uint32_t* GetWeakReferenceData() const { return reinterpret_cast<uint32_t*>(mData + sizeof(uint32_t)); }
+
+    template<typename U>
+    friend class WeakPointer;
+
     /// @brief Internal data structure for the shared pointer.
     uint8_t* mData;
 
@@ -240,15 +265,17 @@ private:
 template<typename T, typename... Args>
 constexpr SharedPointer<T> CreateSharedPointer(Args&&... args)
 {
-    uint8_t* data = new uint8_t[sizeof(uint32_t) + sizeof(T)]; // Allocate memory for the data and the reference count.
+    // Allocate memory for the data and the reference count.
+    uint8_t* data = new uint8_t[SharedPointerDataOffset + sizeof(T)];
 
     // Construct new object in the allocated memory.
-    T* object = new (data + sizeof(uint32_t)) T(std::forward<Args>(args)...);
+    new (data + SharedPointerDataOffset) T(std::forward<Args>(args)...);
     uint32_t* ref = reinterpret_cast<uint32_t*>(data);
 
     // First four bytes of the data is the reference count. Set it to 1 because the shared pointer will have a
-    // reference to it.
-    *ref = 1;
+    // reference to it. The next four are the weak reference count, 1 for all the shared pointers together.
+    ref[0] = 1;
+    ref[1] = 1;
 
     return SharedPointer<T>(data);
 }
@@ -257,15 +284,168 @@ constexpr SharedPointer<T> CreateSharedPointer(Args&&... args)
 template<typename T>
 constexpr SharedPointer<T> CreateSharedPointer()
 {
-    uint8_t* data = new uint8_t[sizeof(uint32_t) + sizeof(T)]; // Allocate memory for the data and the reference count.
+    // Allocate memory for the data and the reference count.
+    uint8_t* data = new uint8_t[SharedPointerDataOffset + sizeof(T)];
 
     // Construct new object in the allocated memory.
-    T* object = new (data + sizeof(uint32_t)) T();
+    new (data + SharedPointerDataOffset) T();
     uint32_t* ref = reinterpret_cast<uint32_t*>(data);
 
     // First four bytes of the data is the reference count. Set it to 1 because the shared pointer will have a
-    // reference to it.
-    *ref = 1;
+    // reference to it. The next four are the weak reference count, 1 for all the shared pointers together.
+    ref[0] = 1;
+    ref[1] = 1;
 
     return SharedPointer<T>(data);
 }
+
+/// @brief Non-owning reference to the object of a SharedPointer. It doesn't keep the object alive, but it can tell
+/// if the object was destroyed and get a SharedPointer to it while it's alive. Like SharedPointer it isn't thread
+/// safe.
+template<typename T>
+class WeakPointer
+{
+public:
+    /// --------------------------------------------------------
+    /// Constructors & Destructor
+    /// --------------------------------------------------------
+
+    /// @brief Default constructor, null pointer.
+    WeakPointer() : mData(nullptr) {}
+
+    /// @brief Constructor from a shared pointer, references its object.
+    /// @param shared the shared pointer.
+    WeakPointer(const SharedPointer<T>& shared) : mData(shared.mData) { AddReference(); }
+
+    /// @brief Copy constructor, increments the weak reference count.
+    /// @param other the other weak pointer.
+    WeakPointer(const WeakPointer& other) : mData(other.mData) { AddReference(); }
+
+    /// @brief Move constructor, moves the data from the other weak pointer.
+    /// @param other the other weak pointer.
+    WeakPointer(WeakPointer&& other) noexcept : mData(other.mData) { other.mData = nullptr; }
+
+    /// @brief Destructor, decrements the weak reference count and deletes the memory if it was the last reference.
+    ~WeakPointer() { RemoveReference(); }
+
+    /// --------------------------------------------------------
+    /// Operators
+    /// --------------------------------------------------------
+
+    /// @brief Copy assignment operator, increments the weak reference count.
+    /// @param other the other weak pointer.
+    /// @return reference to this weak pointer.
+    WeakPointer& operator=(const WeakPointer& other)
+    {
+        if (this != &other)
+        {
+            RemoveReference();
+
+            mData = other.mData;
+
+            AddReference();
+        }
+        return *this;
+    }
+
+    /// @brief Move assignment operator, moves the data from the other weak pointer.
+    /// @param other the other weak pointer.
+    /// @return reference to this weak pointer.
+    WeakPointer& operator=(WeakPointer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            RemoveReference();
+
+            mData = other.mData;
+            other.mData = nullptr;
+        }
+        return *this;
+    }
+
+    bool operator==(std::nullptr_t) const { return mData == nullptr; }
+
+    /// --------------------------------------------------------
+    /// Methods
+    /// --------------------------------------------------------
+
+    /// @brief Check if the object was destroyed, a null weak pointer is expired as well.
+    /// @return true if no shared pointer references the object anymore.
+    bool expired() const { return mData == nullptr || *reinterpret_cast<uint32_t*>(mData) == 0; }
+
+    /// @brief Get a shared pointer to the object.
+    /// @return the shared pointer, or a null shared pointer if the object was destroyed.
+    SharedPointer<T> lock() const
+    {
+        if (expired())
+        {
+            return SharedPointer<T>(nullptr);
+        }
+
+        (*reinterpret_cast<uint32_t*>(mData))++;
+        return SharedPointer<T>(mData);
+    }
+
+    /// @brief Reset the weak pointer removing the reference to the data.
+    void reset()
+    {
+        RemoveReference();
+        mData = nullptr;
+    }
+
+    /// @brief Cast the weak pointer to a weak pointer of another type, this doesn't check if the cast is valid.
+    /// Casting to uint8_t gives a weak reference that can only be checked for expiry, to any type of object.
+    /// @tparam U the type to cast to.
+    /// @return the casted weak pointer.
+    template<typename U>
+    WeakPointer<U> cast() const&
+    {
+        WeakPointer<U> casted;
+        casted.mData = mData;
+        casted.AddReference();
+        return casted;
+    }
+
+    /// @brief Cast a temporary weak pointer to a weak pointer of another type, its reference is handed over.
+    /// @tparam U the type to cast to.
+    /// @return the casted weak pointer.
+    template<typename U>
+    WeakPointer<U> cast() &&
+    {
+        WeakPointer<U> casted;
+        casted.mData = mData;
+        mData = nullptr;
+        return casted;
+    }
+
+private:
+    template<typename U>
+    friend class WeakPointer;
+
+    inline void AddReference()
+    {
+        if (mData == nullptr)
+            return;
+
+        (*reinterpret_cast<uint32_t*>(mData + sizeof(uint32_t)))++;
+    }
+
+    inline void RemoveReference()
+    {
+        if (mData == nullptr)
+            return;
+
+        uint32_t& weakReferenceCount = *reinterpret_cast<uint32_t*>(mData + sizeof(uint32_t));
+
+        weakReferenceCount--;
+
+        // The object was destroyed by the last shared pointer already, only the memory is left.
+        if (weakReferenceCount == 0)
+        {
+            delete[] mData;
+        }
+    }
+
+    /// @brief Internal data structure of the shared pointer the weak pointer was created from.
+    uint8_t* mData;
+};
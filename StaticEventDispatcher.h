@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+/// @brief Binds handlers to an event of a StaticEventDispatcher. The handlers are called in the order they are
+/// listed, they can be pointers to free functions or static member functions, or captureless lambdas, taking the
+/// data by (const) reference. Member function pointers can't be called without an object, wrap them in a lambda that
+/// gets the object from somewhere global:
+///     StaticHandlers<WindowEvent::Resize, &OnResize, &Renderer::OnWindowResize> // OnWindowResize is static
+/// @tparam Event The event enum value.
+/// @tparam Handlers The handlers of the event.
+template<auto Event, auto... Handlers>
+struct StaticHandlers
+{
+    static constexpr auto EventType = Event;
+
+    /// @brief Calls the handlers directly, every call can be inlined.
+    template<typename T>
+    static void Call(T& data)
+    {
+        (Handlers(data), ...);
+    }
+};
+
+/// @brief StaticEventDispatcher is an event dispatcher for events whose handlers are known at compile time, e.g.
+/// the core systems of an engine. The handlers are template parameters, so there is no subscriber map, no
+/// subscriber list and no type erased call: Dispatch<Event>() compiles to the direct calls of the handlers, and the
+/// runtime Dispatch() to a switch over the event types.
+/// Handlers can't be added or removed at runtime, use EventDispatcher for that.
+///     using CoreEvents = StaticEventDispatcher<WindowEvent, WindowData,
+///                                              StaticHandlers<WindowEvent::Resize, &OnResize>,
+///                                              StaticHandlers<WindowEvent::Close, &OnClose, &SaveSettings>>;
+///     CoreEvents::Dispatch<WindowEvent::Resize>(data);
+/// @tparam E Enum type of the event. IT MUST BE AN ENUM CLASS.
+/// @tparam T Data type passed to the handlers.
+/// @tparam Bindings StaticHandlers of the events. An event can be bound more than once, the handlers of all its
+/// bindings are called in the order they are listed.
+template<typename E, typename T, typename... Bindings>
+class StaticEventDispatcher
+{
+public:
+    static_assert(std::is_enum_v<E>, "E must be an enum class.");
+    static_assert((std::is_same_v<std::remove_cv_t<decltype(Bindings::EventType)>, E> && ...),
+                  "Every binding must be a StaticHandlers of an event of type E.");
+
+    /// @brief Enum type of the event.
+    using EventEnum_t = std::underlying_type_t<E>;
+
+    /// @brief Checks if an event has handlers.
+    template<E Event>
+    static constexpr bool HasHandlers = ((Bindings::EventType == Event) || ...);
+
+    /// @brief Dispatches an event known at compile time to its handlers. This is a blocking call.
+    /// @tparam Event The event.
+    /// @param data The data to be passed to the handlers. The data is mutable if T is not const.
+    template<E Event>
+    static void Dispatch(T& data)
+    {
+        (CallIfBound<Event, Bindings>(data), ...);
+    }
+
+    /// @brief Dispatches an event known at runtime to its handlers. The event type is compared with the bound
+    /// event types, which the compiler turns into a switch or a jump table. This is a blocking call.
+    /// @param eventType The type of the event.
+    /// @param data The data to be passed to the handlers. The data is mutable if T is not const.
+    static void Dispatch(E eventType, T& data)
+    {
+        if constexpr (sizeof...(Bindings) != 0)
+        {
+            // Dispatch every bound event type once, so an event bound more than once keeps the order of its handlers.
+            DispatchBound(eventType, data, std::index_sequence_for<Bindings...>());
+        }
+    }
+
+private:
+    template<E Event, typename Binding>
+    static void CallIfBound(T& data)
+    {
+        if constexpr (Binding::EventType == Event)
+        {
+            Binding::Call(data);
+        }
+    }
+
+    /// @brief Event types of the bindings, in the order they are listed.
+    static constexpr std::array<E, sizeof...(Bindings)> BoundEvents = {Bindings::EventType...};
+
+    /// @brief Checks if the binding at an index is the first binding of its event type.
+    static constexpr bool IsFirstBinding(size_t index)
+    {
+        for (size_t i = 0; i < index; i++)
+        {
+            if (BoundEvents[i] == BoundEvents[index])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    template<size_t... Indices>
+    static void DispatchBound(E eventType, T& data, std::index_sequence<Indices...>)
+    {
+        (DispatchIfFirst<Indices>(eventType, data), ...);
+    }
+
+    template<size_t Index>
+    static void DispatchIfFirst(E eventType, T& data)
+    {
+        if constexpr (IsFirstBinding(Index))
+        {
+            if (eventType == BoundEvents[Index])
+            {
+                Dispatch<BoundEvents[Index]>(data);
+            }
+        }
+    }
+};
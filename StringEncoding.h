@@ -0,0 +1,790 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if !defined(UTILLIB_STRING_SCALAR) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <immintrin.h>
+#define UTILLIB_STRING_SSE2
+#if defined(__AVX2__)
+#define UTILLIB_STRING_AVX2
+#endif
+#endif
+
+/// Locale independent conversions between UTF-8 and UTF-16 or UTF-32, used by the strings. The code units of the
+/// wide side are char16_t (UTF-16), char32_t (UTF-32) or wchar_t, which is UTF-16 on Windows and UTF-32 elsewhere.
+/// The conversions validate their input: overlong UTF-8, unpaired surrogates and code points beyond U+10FFFF make
+/// them return Invalid. The Replacing variants and Recode() replace such input with U+FFFD instead.
+/// ASCII is converted a block at a time, with AVX2 or SSE2 when the compiler targets them and 8 bytes at a time
+/// otherwise, define UTILLIB_STRING_SCALAR to leave out the vector code.
+
+namespace StringEncoding
+{
+    /// @brief Returned by the conversions when the input isn't valid.
+    constexpr uint32_t Invalid = UINT32_MAX;
+
+    /// @brief U+FFFD, replaces the input that isn't valid in the Replacing conversions and Recode().
+    constexpr char32_t ReplacementCharacter = 0xFFFD;
+
+    /// @brief Whether code units of C are UTF-16, they're UTF-32 otherwise.
+    template<typename C>
+    constexpr bool IsUtf16 = sizeof(C) == 2;
+
+    /// @brief Bytes converted at a time by the ASCII paths.
+#if defined(UTILLIB_STRING_AVX2)
+    constexpr uint32_t BlockSize = 32;
+#elif defined(UTILLIB_STRING_SSE2)
+    constexpr uint32_t BlockSize = 16;
+#else
+    constexpr uint32_t BlockSize = 8;
+#endif
+
+    /// ---------------------
+    /// ASCII blocks
+    /// ---------------------
+
+    /// @brief Widens the leading ASCII bytes of a string to code units, a block at a time.
+    /// @return Number of bytes widened, all of the ASCII prefix unless the string ends within a block.
+    template<typename C>
+    inline uint32_t WidenAscii(const char* src, uint32_t size, C* dst)
+    {
+        uint32_t i = 0;
+
+        // The ASCII prefix of the block with the first byte that isn't ASCII. The destination may only have room for
+        // the units of a valid string, the block isn't widened as a whole.
+        const auto prefix = [&](uint32_t length) {
+            for (uint32_t j = 0; j < length; j++) { dst[i + j] = static_cast<C>(src[i + j]); }
+
+            return i + length;
+        };
+
+#if defined(UTILLIB_STRING_AVX2)
+        for (; i + 32 <= size; i += 32)
+        {
+            const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            const uint32_t nonAscii = static_cast<uint32_t>(_mm256_movemask_epi8(bytes));
+
+            if (nonAscii != 0)
+            {
+                return prefix(std::countr_zero(nonAscii));
+            }
+
+            const __m128i low = _mm256_castsi256_si128(bytes);
+            const __m128i high = _mm256_extracti128_si256(bytes, 1);
+            __m256i* out = reinterpret_cast<__m256i*>(dst + i);
+
+            if constexpr (IsUtf16<C>)
+            {
+                _mm256_storeu_si256(out, _mm256_cvtepu8_epi16(low));
+                _mm256_storeu_si256(out + 1, _mm256_cvtepu8_epi16(high));
+            }
+            else
+            {
+                _mm256_storeu_si256(out, _mm256_cvtepu8_epi32(low));
+                _mm256_storeu_si256(out + 1, _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+                _mm256_storeu_si256(out + 2, _mm256_cvtepu8_epi32(high));
+                _mm256_storeu_si256(out + 3, _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+            }
+        }
+#elif defined(UTILLIB_STRING_SSE2)
+        for (; i + 16 <= size; i += 16)
+        {
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            const uint32_t nonAscii = static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+
+            if (nonAscii != 0)
+            {
+                return prefix(std::countr_zero(nonAscii));
+            }
+
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+            const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+            __m128i* out = reinterpret_cast<__m128i*>(dst + i);
+
+            if constexpr (IsUtf16<C>)
+            {
+                _mm_storeu_si128(out, low);
+                _mm_storeu_si128(out + 1, high);
+            }
+            else
+            {
+                _mm_storeu_si128(out, _mm_unpacklo_epi16(low, zero));
+                _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(low, zero));
+                _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(high, zero));
+                _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(high, zero));
+            }
+        }
+#else
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, src + i, sizeof(word));
+
+            if ((word & 0x8080808080808080) != 0)
+            {
+                return prefix(std::countr_zero(word & 0x8080808080808080) / 8);
+            }
+
+            for (uint32_t j = 0; j < 8; j++) { dst[i + j] = static_cast<C>(src[i + j]); }
+        }
+#endif
+
+        return i;
+    }
+
+    /// @brief Narrows the leading ASCII code units of a string to bytes, a block at a time. Every unit is at least a
+    /// byte of UTF-8, so the block with the first unit that isn't ASCII is narrowed as a whole, the bytes after its
+    /// ASCII prefix are overwritten later.
+    /// @return Number of units narrowed, all of the ASCII prefix unless the string ends within a block.
+    template<typename C>
+    inline uint32_t NarrowAscii(const C* src, uint32_t size, char* dst)
+    {
+        uint32_t i = 0;
+
+#if defined(UTILLIB_STRING_AVX2)
+        for (; i + 32 <= size; i += 32)
+        {
+            const __m256i* in = reinterpret_cast<const __m256i*>(src + i);
+            __m256i bytes;
+
+            if constexpr (IsUtf16<C>)
+            {
+                const __m256i a = _mm256_loadu_si256(in);
+                const __m256i b = _mm256_loadu_si256(in + 1);
+
+                // The packs work within 128 bit lanes, the permutation puts the quarters back in order.
+                bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+
+                const __m256i high = _mm256_set1_epi16(static_cast<short>(0xFF80));
+
+                if (!_mm256_testz_si256(_mm256_or_si256(a, b), high))
+                {
+                    const auto asciiMask = [&](__m256i units) {
+                        return static_cast<uint32_t>(_mm256_movemask_epi8(
+                            _mm256_cmpeq_epi16(_mm256_and_si256(units, high), _mm256_setzero_si256())));
+                    };
+                    const uint64_t ascii = asciiMask(a) | uint64_t(asciiMask(b)) << 32;
+
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), bytes);
+                    return i + std::countr_one(ascii) / 2;
+                }
+            }
+            else
+            {
+                const __m256i a = _mm256_loadu_si256(in);
+                const __m256i b = _mm256_loadu_si256(in + 1);
+                const __m256i c = _mm256_loadu_si256(in + 2);
+                const __m256i d = _mm256_loadu_si256(in + 3);
+                const __m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+                const __m256i high = _mm256_set1_epi32(~0x7F);
+
+                const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+                bytes = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+
+                if (!_mm256_testz_si256(any, high))
+                {
+                    const __m256i zero = _mm256_setzero_si256();
+                    const auto asciiMask = [&](__m256i units) {
+                        return static_cast<uint32_t>(_mm256_movemask_ps(
+                            _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(units, high), zero))));
+                    };
+                    const uint32_t ascii =
+                        asciiMask(a) | asciiMask(b) << 8 | asciiMask(c) << 16 | asciiMask(d) << 24;
+
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), bytes);
+                    return i + std::countr_one(ascii);
+                }
+            }
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), bytes);
+        }
+#elif defined(UTILLIB_STRING_SSE2)
+        for (; i + 16 <= size; i += 16)
+        {
+            const __m128i* in = reinterpret_cast<const __m128i*>(src + i);
+            const __m128i zero = _mm_setzero_si128();
+            __m128i bytes;
+
+            if constexpr (IsUtf16<C>)
+            {
+                const __m128i a = _mm_loadu_si128(in);
+                const __m128i b = _mm_loadu_si128(in + 1);
+                const __m128i high = _mm_set1_epi16(static_cast<short>(0xFF80));
+
+                bytes = _mm_packus_epi16(a, b);
+
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(a, b), high), zero)) != 0xFFFF)
+                {
+                    const uint32_t ascii =
+                        static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(a, high), zero))) |
+                        static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(b, high), zero))) << 16;
+
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), bytes);
+                    return i + std::countr_one(ascii) / 2;
+                }
+            }
+            else
+            {
+                const __m128i a = _mm_loadu_si128(in);
+                const __m128i b = _mm_loadu_si128(in + 1);
+                const __m128i c = _mm_loadu_si128(in + 2);
+                const __m128i d = _mm_loadu_si128(in + 3);
+                const __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+                const __m128i high = _mm_set1_epi32(~0x7F);
+
+                bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, high), zero)) != 0xFFFF)
+                {
+                    const auto asciiMask = [&](__m128i units) {
+                        return static_cast<uint32_t>(
+                            _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(units, high), zero))));
+                    };
+                    const uint32_t ascii = asciiMask(a) | asciiMask(b) << 4 | asciiMask(c) << 8 | asciiMask(d) << 12;
+
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), bytes);
+                    return i + std::countr_one(ascii);
+                }
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), bytes);
+        }
+#else
+        for (; i + 8 <= size; i += 8)
+        {
+            uint32_t bits = 0;
+            for (uint32_t j = 0; j < 8; j++) { bits |= static_cast<uint32_t>(src[i + j]); }
+
+            if (bits >= 0x80)
+            {
+                while (static_cast<uint32_t>(src[i]) < 0x80) { dst[i] = static_cast<char>(src[i]); i++; }
+
+                return i;
+            }
+
+            for (uint32_t j = 0; j < 8; j++) { dst[i + j] = static_cast<char>(src[i + j]); }
+        }
+#endif
+
+        return i;
+    }
+
+    /// ---------------------
+    /// Lengths
+    /// ---------------------
+
+    /// @brief Get the number of C code units of a valid UTF-8 string. For invalid UTF-8 it's at least the number of
+    /// units FromUtf8() writes before it fails.
+    template<typename C>
+    inline uint32_t LengthFromUtf8(const char* src, uint32_t size)
+    {
+        // A code point per byte that isn't a continuation byte (0x80 to 0xBF), in UTF-16 the code points of four byte
+        // sequences (lead bytes 0xF0 and up) take two units.
+        uint32_t count = 0;
+        uint32_t i = 0;
+
+#if defined(UTILLIB_STRING_AVX2)
+        for (; i + 32 <= size; i += 32)
+        {
+            const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+
+            // Continuation bytes are -128 to -65 as signed bytes, four byte leads -16 to -1.
+            count += std::popcount(static_cast<uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(-65)))));
+
+            if constexpr (IsUtf16<C>)
+            {
+                count += std::popcount(
+                    static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(-17))) &
+                                          _mm256_movemask_epi8(bytes)));
+            }
+        }
+#elif defined(UTILLIB_STRING_SSE2)
+        for (; i + 16 <= size; i += 16)
+        {
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+            // Continuation bytes are -128 to -65 as signed bytes, four byte leads -16 to -1.
+            count += std::popcount(
+                static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(-65)))));
+
+            if constexpr (IsUtf16<C>)
+            {
+                count += std::popcount(static_cast<uint32_t>(
+                    _mm_movemask_epi8(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(-17))) & _mm_movemask_epi8(bytes)));
+            }
+        }
+#endif
+
+        for (; i < size; i++)
+        {
+            const uint8_t byte = static_cast<uint8_t>(src[i]);
+
+            count += (byte & 0xC0) != 0x80;
+
+            if constexpr (IsUtf16<C>)
+            {
+                count += byte >= 0xF0;
+            }
+        }
+
+        return count;
+    }
+
+    /// @brief Get the number of bytes of a valid UTF-16 or UTF-32 string converted to UTF-8. For invalid strings it's
+    /// at least the number of bytes ToUtf8() writes before it fails.
+    template<typename C>
+    inline uint32_t Utf8Length(const C* src, uint32_t size)
+    {
+        uint32_t count = 0;
+        uint32_t i = 0;
+
+        if constexpr (IsUtf16<C>)
+        {
+            // 3 bytes per unit, less one below 0x800, one more below 0x80 and one for each half of a surrogate pair.
+#if defined(UTILLIB_STRING_AVX2)
+            for (; i + 16 <= size; i += 16)
+            {
+                const __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                const __m256i zero = _mm256_setzero_si256();
+
+                const uint32_t below80 = static_cast<uint32_t>(
+                    _mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_subs_epu16(units, _mm256_set1_epi16(0x7F)), zero)));
+                const uint32_t below800 = static_cast<uint32_t>(_mm256_movemask_epi8(
+                    _mm256_cmpeq_epi16(_mm256_subs_epu16(units, _mm256_set1_epi16(0x7FF)), zero)));
+                const uint32_t surrogates = static_cast<uint32_t>(_mm256_movemask_epi8(
+                    _mm256_cmpeq_epi16(_mm256_and_si256(units, _mm256_set1_epi16(static_cast<short>(0xF800))),
+                                       _mm256_set1_epi16(static_cast<short>(0xD800)))));
+
+                // Two mask bits per unit.
+                count += 48 - (std::popcount(below80) + std::popcount(below800) + std::popcount(surrogates)) / 2;
+            }
+#elif defined(UTILLIB_STRING_SSE2)
+            for (; i + 8 <= size; i += 8)
+            {
+                const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                const __m128i zero = _mm_setzero_si128();
+
+                const uint32_t below80 = static_cast<uint32_t>(
+                    _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(units, _mm_set1_epi16(0x7F)), zero)));
+                const uint32_t below800 = static_cast<uint32_t>(
+                    _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(units, _mm_set1_epi16(0x7FF)), zero)));
+                const uint32_t surrogates = static_cast<uint32_t>(
+                    _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xF800))),
+                                                      _mm_set1_epi16(static_cast<short>(0xD800)))));
+
+                // Two mask bits per unit.
+                count += 24 - (std::popcount(below80) + std::popcount(below800) + std::popcount(surrogates)) / 2;
+            }
+#endif
+
+            for (; i < size; i++)
+            {
+                const char32_t unit = static_cast<char16_t>(src[i]);
+
+                count += 3 - (unit < 0x80) - (unit < 0x800) - ((unit & 0xF800) == 0xD800);
+            }
+        }
+        else
+        {
+            // 1 byte per unit, one more from 0x80, 0x800 and 0x10000 on.
+#if defined(UTILLIB_STRING_AVX2)
+            for (; i + 8 <= size; i += 8)
+            {
+                const __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+
+                const uint32_t from80 = static_cast<uint32_t>(
+                    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(units, _mm256_set1_epi32(0x7F)))));
+                const uint32_t from800 = static_cast<uint32_t>(
+                    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(units, _mm256_set1_epi32(0x7FF)))));
+                const uint32_t from10000 = static_cast<uint32_t>(
+                    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(units, _mm256_set1_epi32(0xFFFF)))));
+
+                count += 8 + std::popcount(from80) + std::popcount(from800) + std::popcount(from10000);
+            }
+#elif defined(UTILLIB_STRING_SSE2)
+            for (; i + 4 <= size; i += 4)
+            {
+                const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+                const uint32_t from80 = static_cast<uint32_t>(
+                    _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(units, _mm_set1_epi32(0x7F)))));
+                const uint32_t from800 = static_cast<uint32_t>(
+                    _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(units, _mm_set1_epi32(0x7FF)))));
+                const uint32_t from10000 = static_cast<uint32_t>(
+                    _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(units, _mm_set1_epi32(0xFFFF)))));
+
+                count += 4 + std::popcount(from80) + std::popcount(from800) + std::popcount(from10000);
+            }
+#endif
+
+            for (; i < size; i++)
+            {
+                const char32_t unit = static_cast<char32_t>(src[i]);
+
+                count += 1 + (unit >= 0x80) + (unit >= 0x800) + (unit >= 0x10000);
+            }
+        }
+
+        return count;
+    }
+
+    /// ---------------------
+    /// Code points
+    /// ---------------------
+
+    /// @brief Decodes the UTF-8 sequence of a code point that isn't ASCII.
+    /// @param size Number of bytes left in the string.
+    /// @return Length of the sequence, 0 if it isn't valid.
+    inline uint32_t DecodeUtf8(const uint8_t* src, uint32_t size, char32_t& codePoint)
+    {
+        const uint32_t lead = src[0];
+
+        // 0xC0 and 0xC1 would only lead overlong two byte sequences.
+        if (lead < 0xE0)
+        {
+            if (lead < 0xC2 || size < 2 || (src[1] & 0xC0) != 0x80)
+            {
+                return 0;
+            }
+
+            codePoint = ((lead & 0x1F) << 6) | (src[1] & 0x3F);
+            return 2;
+        }
+
+        if (lead < 0xF0)
+        {
+            if (size < 3 || ((src[1] & 0xC0) != 0x80) | ((src[2] & 0xC0) != 0x80))
+            {
+                return 0;
+            }
+
+            codePoint = ((lead & 0x0F) << 12) | ((src[1] & 0x3F) << 6) | (src[2] & 0x3F);
+
+            const bool surrogate = codePoint >= 0xD800 && codePoint < 0xE000;
+            return codePoint >= 0x800 && !surrogate ? 3 : 0;
+        }
+
+        if (lead >= 0xF5 || size < 4 || ((src[1] & 0xC0) != 0x80) | ((src[2] & 0xC0) != 0x80) |
+                                            ((src[3] & 0xC0) != 0x80))
+        {
+            return 0;
+        }
+
+        codePoint = ((lead & 0x07) << 18) | ((src[1] & 0x3F) << 12) | ((src[2] & 0x3F) << 6) | (src[3] & 0x3F);
+
+        return codePoint >= 0x10000 && codePoint <= 0x10FFFF ? 4 : 0;
+    }
+
+    /// @brief Encodes a valid code point to UTF-8.
+    /// @return Number of bytes written.
+    inline uint32_t EncodeUtf8(char32_t codePoint, char* dst)
+    {
+        if (codePoint < 0x80)
+        {
+            dst[0] = static_cast<char>(codePoint);
+            return 1;
+        }
+
+        if (codePoint < 0x800)
+        {
+            dst[0] = static_cast<char>(0xC0 | (codePoint >> 6));
+            dst[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            return 2;
+        }
+
+        if (codePoint < 0x10000)
+        {
+            dst[0] = static_cast<char>(0xE0 | (codePoint >> 12));
+            dst[1] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            dst[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            return 3;
+        }
+
+        dst[0] = static_cast<char>(0xF0 | (codePoint >> 18));
+        dst[1] = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        dst[2] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        dst[3] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        return 4;
+    }
+
+    /// @brief Encodes a valid code point to UTF-16 or UTF-32.
+    /// @return Number of units written.
+    template<typename C>
+    inline uint32_t EncodeUnits(char32_t codePoint, C* dst)
+    {
+        if constexpr (IsUtf16<C>)
+        {
+            if (codePoint >= 0x10000)
+            {
+                dst[0] = static_cast<C>(0xD800 + ((codePoint - 0x10000) >> 10));
+                dst[1] = static_cast<C>(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+                return 2;
+            }
+        }
+
+        dst[0] = static_cast<C>(codePoint);
+        return 1;
+    }
+
+    /// ---------------------
+    /// Conversions
+    /// ---------------------
+
+    /// @brief Converts UTF-8 to UTF-16 or UTF-32.
+    /// @param dst Destination with room for LengthFromUtf8<C>() units, or for one unit per byte.
+    /// @return Number of units written, Invalid if the string isn't valid UTF-8.
+    template<typename C>
+    inline uint32_t FromUtf8(const char* src, uint32_t size, C* dst)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(src);
+
+        uint32_t i = 0;
+        uint32_t count = 0;
+
+        while (i < size)
+        {
+            const uint32_t ascii = WidenAscii(src + i, size - i, dst + count);
+            i += ascii;
+            count += ascii;
+
+            // Decodes a block one sequence at a time, then the ASCII path gets another try.
+            const uint32_t end = size - i > BlockSize ? i + BlockSize : size;
+
+            while (i < end)
+            {
+                if (bytes[i] < 0x80)
+                {
+                    dst[count++] = static_cast<C>(bytes[i++]);
+                    continue;
+                }
+
+                char32_t codePoint;
+                const uint32_t length = DecodeUtf8(bytes + i, size - i, codePoint);
+
+                if (length == 0)
+                {
+                    return Invalid;
+                }
+
+                i += length;
+                count += EncodeUnits(codePoint, dst + count);
+            }
+        }
+
+        return count;
+    }
+
+    /// @brief Converts UTF-16 or UTF-32 to UTF-8.
+    /// @param dst Destination with room for Utf8Length() bytes, or for 3 bytes per UTF-16 or 4 per UTF-32 unit.
+    /// @return Number of bytes written, Invalid if the string isn't valid UTF-16 or UTF-32.
+    template<typename C>
+    inline uint32_t ToUtf8(const C* src, uint32_t size, char* dst)
+    {
+        uint32_t i = 0;
+        uint32_t count = 0;
+
+        while (i < size)
+        {
+            const uint32_t ascii = NarrowAscii(src + i, size - i, dst + count);
+            i += ascii;
+            count += ascii;
+
+            // Encodes a block one code point at a time, then the ASCII path gets another try.
+            const uint32_t end = size - i > BlockSize ? i + BlockSize : size;
+
+            while (i < end)
+            {
+                char32_t codePoint = IsUtf16<C> ? static_cast<char16_t>(src[i++]) : static_cast<char32_t>(src[i++]);
+
+                if (codePoint < 0x80)
+                {
+                    dst[count++] = static_cast<char>(codePoint);
+                    continue;
+                }
+
+                if (codePoint >= 0xD800 && codePoint < 0xE000)
+                {
+                    if constexpr (!IsUtf16<C>)
+                    {
+                        return Invalid;
+                    }
+
+                    const char32_t low = i < size ? static_cast<char16_t>(src[i]) : 0;
+
+                    if (codePoint >= 0xDC00 || low < 0xDC00 || low >= 0xE000)
+                    {
+                        return Invalid;
+                    }
+
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    i++;
+                }
+                else if (codePoint > 0x10FFFF)
+                {
+                    return Invalid;
+                }
+
+                count += EncodeUtf8(codePoint, dst + count);
+            }
+        }
+
+        return count;
+    }
+
+    /// @brief Converts UTF-8 to UTF-16 or UTF-32 like FromUtf8(), but every byte that doesn't start a valid sequence
+    /// becomes U+FFFD and the conversion goes on with the next byte. Decodes a sequence at a time, for the strings
+    /// FromUtf8() rejected.
+    /// @param dst Destination of the units, nullptr to only count them.
+    /// @return Number of units written.
+    template<typename C>
+    inline uint32_t FromUtf8Replacing(const char* src, uint32_t size, C* dst)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(src);
+
+        uint32_t count = 0;
+
+        for (uint32_t i = 0; i < size;)
+        {
+            char32_t codePoint = bytes[i];
+            uint32_t length = 1;
+
+            if (codePoint >= 0x80)
+            {
+                length = DecodeUtf8(bytes + i, size - i, codePoint);
+
+                if (length == 0)
+                {
+                    codePoint = ReplacementCharacter;
+                    length = 1;
+                }
+            }
+
+            i += length;
+
+            if (dst)
+            {
+                count += EncodeUnits(codePoint, dst + count);
+            }
+            else
+            {
+                count += IsUtf16<C> && codePoint >= 0x10000 ? 2 : 1;
+            }
+        }
+
+        return count;
+    }
+
+    /// @brief Converts UTF-16 or UTF-32 to UTF-8 like ToUtf8(), but unpaired surrogates and code points beyond
+    /// U+10FFFF become U+FFFD. Encodes a code point at a time, for the strings ToUtf8() rejected.
+    /// @param dst Destination of the bytes, nullptr to only count them.
+    /// @return Number of bytes written.
+    template<typename C>
+    inline uint32_t ToUtf8Replacing(const C* src, uint32_t size, char* dst)
+    {
+        uint32_t count = 0;
+
+        for (uint32_t i = 0; i < size; i++)
+        {
+            char32_t codePoint = IsUtf16<C> ? static_cast<char16_t>(src[i]) : static_cast<char32_t>(src[i]);
+
+            if (codePoint >= 0xD800 && codePoint < 0xE000)
+            {
+                // UTF-32 has no surrogate pairs, a surrogate is never followed by its low half there.
+                const char32_t low = IsUtf16<C> && i + 1 < size ? static_cast<char16_t>(src[i + 1]) : 0;
+                const bool paired = codePoint < 0xDC00 && low >= 0xDC00 && low < 0xE000;
+
+                codePoint = paired ? 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00) : ReplacementCharacter;
+                i += paired;
+            }
+            else if (codePoint > 0x10FFFF)
+            {
+                codePoint = ReplacementCharacter;
+            }
+
+            if (dst)
+            {
+                count += EncodeUtf8(codePoint, dst + count);
+            }
+            else
+            {
+                count += 1 + (codePoint >= 0x80) + (codePoint >= 0x800) + (codePoint >= 0x10000);
+            }
+        }
+
+        return count;
+    }
+
+    /// @brief Recodes UTF-16 or UTF-32 code units to units of another width, unpaired surrogates become U+FFFD.
+    /// @param dst Destination of the units, nullptr to only count them.
+    /// @return Number of units written.
+    template<typename To, typename From>
+    inline uint32_t Recode(const From* src, uint32_t size, To* dst)
+    {
+        if constexpr (sizeof(To) == sizeof(From))
+        {
+            if (dst)
+            {
+                memcpy(dst, src, size * sizeof(From));
+            }
+
+            return size;
+        }
+        else if constexpr (IsUtf16<From>)
+        {
+            // UTF-16 to UTF-32, a surrogate pair becomes one unit.
+            uint32_t count = 0;
+
+            for (uint32_t i = 0; i < size; i++, count++)
+            {
+                char32_t unit = static_cast<char16_t>(src[i]);
+
+                if (unit >= 0xD800 && unit < 0xE000)
+                {
+                    const char32_t next = i + 1 < size ? static_cast<char16_t>(src[i + 1]) : 0;
+                    const bool paired = unit < 0xDC00 && next >= 0xDC00 && next < 0xE000;
+
+                    unit = paired ? 0x10000 + ((unit - 0xD800) << 10) + (next - 0xDC00) : ReplacementCharacter;
+                    i += paired;
+                }
+
+                if (dst)
+                {
+                    dst[count] = static_cast<To>(unit);
+                }
+            }
+
+            return count;
+        }
+        else
+        {
+            // UTF-32 to UTF-16, code points beyond the BMP become a surrogate pair.
+            uint32_t count = 0;
+
+            for (uint32_t i = 0; i < size; i++)
+            {
+                char32_t unit = static_cast<char32_t>(src[i]);
+
+                if (unit > 0x10FFFF || (unit >= 0xD800 && unit < 0xE000))
+                {
+                    unit = ReplacementCharacter;
+                }
+
+                if (dst)
+                {
+                    count += EncodeUnits(unit, dst + count);
+                }
+                else
+                {
+                    count += unit >= 0x10000 ? 2 : 1;
+                }
+            }
+
+            return count;
+        }
+    }
+} // namespace StringEncoding
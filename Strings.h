@@ -1,14 +1,229 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <cwchar>
+#include <stdexcept>
 #include <string>
 #include <cstring>
+#include <type_traits>
+#include <utility>
 #include <unordered_map> // For hash functions
 
+#include "StringEncoding.h"
+
 class NarrowString;
 class WideString;
 
-/// @brief NarrowString class.
+template<typename C>
+class BasicWideString;
+
+/// @brief UTF-16 string, twice as compact as WideString on Linux.
+using Utf16String = BasicWideString<char16_t>;
+
+/// @brief UTF-32 string.
+using Utf32String = BasicWideString<char32_t>;
+
+/// @brief StringBuffer stores the code units of a string with a terminator. Up to InlineCapacity units are stored in
+/// the buffer itself, longer strings on the heap. Moving a buffer never copies heap units, they're handed over.
+/// Sizes are 32 bit, a longer string throws std::length_error like std::string does instead of being truncated.
+/// @tparam C Code unit type.
+template<typename C>
+class StringBuffer
+{
+public:
+    /// @brief Units stored in the buffer itself, sized so a buffer is 32 bytes.
+    static constexpr uint32_t InlineCapacity = 24 / sizeof(C) - 1;
+
+    /// @brief Most units a buffer holds, so the units and the terminator can be counted in 32 bits.
+    static constexpr uint32_t MaxSize = UINT32_MAX - 1;
+
+    /// @brief Checks that a string of size units fits a buffer, the conversions count their units in 32 bits as well.
+    /// @return The size.
+    static uint32_t CheckSize(uint64_t size)
+    {
+        if (size > MaxSize)
+        {
+            throw std::length_error("String is longer than StringBuffer::MaxSize units.");
+        }
+
+        return static_cast<uint32_t>(size);
+    }
+
+    StringBuffer() { mInline[0] = C(0); }
+
+    StringBuffer(const StringBuffer& other) : StringBuffer() { Assign(other.Data(), other.mSize); }
+
+    StringBuffer(StringBuffer&& other) noexcept { Steal(other); }
+
+    StringBuffer& operator=(const StringBuffer& other)
+    {
+        if (this != &other)
+        {
+            Assign(other.Data(), other.mSize);
+        }
+
+        return *this;
+    }
+
+    StringBuffer& operator=(StringBuffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Free();
+            Steal(other);
+        }
+
+        return *this;
+    }
+
+    ~StringBuffer() { Free(); }
+
+    bool operator==(const StringBuffer& other) const
+    {
+        return mSize == other.mSize && memcmp(Data(), other.Data(), mSize * sizeof(C)) == 0;
+    }
+
+    const C* Data() const { return IsInline() ? mInline : mHeap; }
+
+    uint32_t Size() const { return mSize; }
+
+    uint32_t Capacity() const { return mCapacity; }
+
+    /// @brief Makes room for size units and the terminator, the units of the string are not kept.
+    /// @return The units, the string is complete after Resize().
+    C* Reserve(uint32_t size)
+    {
+        CheckSize(size);
+
+        if (size <= mCapacity)
+        {
+            return IsInline() ? mInline : mHeap;
+        }
+
+        Free();
+
+        mHeap = new C[size + 1];
+        mCapacity = size;
+
+        return mHeap;
+    }
+
+    /// @brief Sets the size of the string written to the units from Reserve() and terminates it.
+    void Resize(uint32_t size)
+    {
+        (IsInline() ? mInline : mHeap)[size] = C(0);
+        mSize = size;
+    }
+
+    void Assign(const C* str, size_t size)
+    {
+        const uint32_t length = CheckSize(size);
+
+        memcpy(Reserve(length), str, length * sizeof(C));
+        Resize(length);
+    }
+
+    /// @brief Assigns a string of other code units, converted between UTF-8, UTF-16 and UTF-32. Input that isn't
+    /// valid is replaced with U+FFFD, by a slower second conversion once the validating one failed. The worst case
+    /// length of the converted string has to fit MaxSize.
+    template<typename D>
+    void AssignConverted(const D* str, size_t unitCount)
+    {
+        const uint32_t size = CheckSize(unitCount);
+
+        if constexpr (sizeof(D) == sizeof(C))
+        {
+            Assign(reinterpret_cast<const C*>(str), size);
+        }
+        else if constexpr (sizeof(D) == 1)
+        {
+            // The units are only counted if the worst case of a unit per byte doesn't fit already.
+            const uint32_t length = size <= mCapacity ? size : StringEncoding::LengthFromUtf8<C>(str, size);
+            uint32_t count = StringEncoding::FromUtf8(str, size, Reserve(length));
+
+            if (count == StringEncoding::Invalid)
+            {
+                count = StringEncoding::FromUtf8Replacing(str, size, static_cast<C*>(nullptr));
+                StringEncoding::FromUtf8Replacing(str, size, Reserve(count));
+            }
+
+            Resize(count);
+        }
+        else if constexpr (sizeof(C) == 1)
+        {
+            const uint32_t worstLength = CheckSize(uint64_t(size) * (StringEncoding::IsUtf16<D> ? 3 : 4));
+            const uint32_t length = worstLength <= mCapacity ? worstLength : StringEncoding::Utf8Length(str, size);
+            uint32_t count = StringEncoding::ToUtf8(str, size, Reserve(length));
+
+            if (count == StringEncoding::Invalid)
+            {
+                count = StringEncoding::ToUtf8Replacing(str, size, static_cast<char*>(nullptr));
+                StringEncoding::ToUtf8Replacing(str, size, Reserve(count));
+            }
+
+            Resize(count);
+        }
+        else
+        {
+            // A UTF-32 unit may become a surrogate pair.
+            CheckSize(uint64_t(size) * (StringEncoding::IsUtf16<C> ? 2 : 1));
+
+            const uint32_t count = StringEncoding::Recode(str, size, static_cast<C*>(nullptr));
+
+            StringEncoding::Recode(str, size, Reserve(count));
+            Resize(count);
+        }
+    }
+
+private:
+    bool IsInline() const { return mCapacity == InlineCapacity; }
+
+    /// @brief Takes the units of another buffer and leaves it empty.
+    void Steal(StringBuffer& other)
+    {
+        // Copies the inline units or the heap pointer, whichever the other buffer holds.
+        memcpy(mInline, other.mInline, sizeof(mInline));
+
+        mSize = other.mSize;
+        mCapacity = other.mCapacity;
+
+        other.mInline[0] = C(0);
+        other.mSize = 0;
+        other.mCapacity = InlineCapacity;
+    }
+
+    /// @brief Frees the heap units, the buffer is inline afterwards.
+    void Free()
+    {
+        if (!IsInline())
+        {
+            delete[] mHeap;
+
+            mInline[0] = C(0);
+            mSize = 0;
+            mCapacity = InlineCapacity;
+        }
+    }
+
+    /// @brief Units with a terminator, inline up to InlineCapacity units and on the heap beyond.
+    union
+    {
+        C mInline[InlineCapacity + 1];
+
+        C* mHeap;
+    };
+
+    uint32_t mSize = 0;
+
+    /// @brief InlineCapacity while the string is inline, the size of the heap buffer without its terminator otherwise.
+    uint32_t mCapacity = InlineCapacity;
+};
+
+/// @brief NarrowString class, UTF-8 encoded. Strings of up to InlineCapacity characters are stored in the object
+/// itself, longer ones on the heap. Moving a string never copies heap characters, the buffer is handed over.
+/// Conversions to and from the wide strings don't depend on the locale. Every conversion, including the ones to STL
+/// strings, replaces the input that isn't valid UTF-8, UTF-16 or UTF-32 with U+FFFD.
 class NarrowString
 {
 public:
@@ -31,9 +246,10 @@ public:
     /// @param str Wide string.
     NarrowString(const wchar_t* str);
 
-    /// @brief Constructor from WideString.
-    /// @param str WideString.
-    NarrowString(const WideString& str);
+    /// @brief Constructor from WideString, Utf16String or Utf32String.
+    /// @param str Wide string.
+    template<typename C>
+    NarrowString(const BasicWideString<C>& str);
 
     /// @brief Destructor.
     ~NarrowString();
@@ -87,66 +303,97 @@ public:
     /// @return String.
     const char* data() const;
 
-private:
-    char mStr[32];
+    /// @brief Get the number of characters that fit without allocating.
+    /// @return Capacity of the string.
+    uint32_t capacity() const;
 
-    uint32_t mSize = 0;
+    /// @brief Characters stored in the object itself.
+    static constexpr uint32_t InlineCapacity = StringBuffer<char>::InlineCapacity;
+
+private:
+    StringBuffer<char> mBuffer;
 };
 
-/// @brief WideString class.
-class WideString
+static_assert(sizeof(NarrowString) == 32);
+
+/// @brief Wide string of C code units: wchar_t, char16_t (UTF-16) or char32_t (UTF-32). Strings of up to
+/// InlineCapacity units are stored in the object itself, longer ones on the heap. Every width is 32 bytes, narrower
+/// units fit more characters inline and take less memory on the heap. Conversions replace unpaired surrogates and
+/// code points beyond U+10FFFF with U+FFFD, like the ones of NarrowString.
+/// @tparam C Code unit type.
+template<typename C>
+class BasicWideString
 {
+    static_assert(std::is_same_v<C, wchar_t> || std::is_same_v<C, char16_t> || std::is_same_v<C, char32_t>,
+                  "BasicWideString needs wchar_t, char16_t or char32_t code units.");
+
 public:
     /// @brief Default constructor.
-    WideString();
+    BasicWideString();
 
     /// @brief Constructor from string.
     /// @param str String.
-    WideString(const std::string& str);
+    BasicWideString(const std::string& str);
 
     /// @brief Constructor from string.
     /// @param str String.
-    WideString(const char* str);
+    BasicWideString(const char* str);
 
     /// @brief Constructor from wide string.
     /// @param str Wide string.
-    WideString(const std::wstring& str);
+    BasicWideString(const std::wstring& str);
 
     /// @brief Constructor from wide string.
     /// @param str Wide string.
-    WideString(const wchar_t* str);
+    BasicWideString(const wchar_t* str);
+
+    /// @brief Constructor from code units.
+    /// @param str String of code units.
+    BasicWideString(const std::basic_string<C>& str)
+        requires(!std::is_same_v<C, wchar_t>);
+
+    /// @brief Constructor from code units.
+    /// @param str String of code units.
+    BasicWideString(const C* str)
+        requires(!std::is_same_v<C, wchar_t>);
 
     /// @brief Constructor from NarrowString.
     /// @param str NarrowString.
-    WideString(const NarrowString& str);
+    BasicWideString(const NarrowString& str);
+
+    /// @brief Constructor from a wide string of another code unit width.
+    /// @param str Wide string.
+    template<typename D>
+        requires(!std::is_same_v<C, D>)
+    explicit BasicWideString(const BasicWideString<D>& str);
 
     /// @brief Destructor.
-    ~WideString();
+    ~BasicWideString();
 
     /// @brief Copy constructor.
     /// @param other Other string.
-    WideString(const WideString& other);
+    BasicWideString(const BasicWideString& other);
 
     /// @brief Move constructor.
     /// @param other Other string.
-    WideString(WideString&& other) noexcept;
+    BasicWideString(BasicWideString&& other) noexcept;
 
     /// @brief Copy assignment operator.
     /// @param other Other string.
-    WideString& operator=(const WideString& other);
+    BasicWideString& operator=(const BasicWideString& other);
 
     /// @brief Move assignment operator.
     /// @param other Other string.
-    WideString& operator=(WideString&& other) noexcept;
+    BasicWideString& operator=(BasicWideString&& other) noexcept;
 
     /// @brief Equality operator.
     /// @param other Other string.
-    bool operator==(const WideString& other) const;
+    bool operator==(const BasicWideString& other) const;
 
     /// @brief Array subscript operator.
     /// @param index Index.
-    /// @return Character at the index.
-    const wchar_t& operator[](uint32_t index) const;
+    /// @return Code unit at the index.
+    const C& operator[](uint32_t index) const;
 
     /// @brief Conversion to STL string.
     operator std::string();
@@ -160,231 +407,265 @@ public:
     /// ---------------------
 
     /// @brief Get the size of the string.
-    /// @return Size of the string.
+    /// @return Number of code units of the string.
     uint32_t size() const;
 
     /// @brief Get the string.
     /// @return String.
-    const wchar_t* c_str() const;
+    const C* c_str() const;
 
     /// @brief Get the string.
     /// @return String.
-    const wchar_t* data() const;
+    const C* data() const;
+
+    /// @brief Get the number of code units that fit without allocating.
+    /// @return Capacity of the string.
+    uint32_t capacity() const;
+
+    /// @brief Code units stored in the object itself.
+    static constexpr uint32_t InlineCapacity = StringBuffer<C>::InlineCapacity;
 
 private:
-    wchar_t mStr[32];
+    StringBuffer<C> mBuffer;
+};
 
-    uint32_t mSize = 0;
+/// @brief Wide string of the platform, UTF-32 on Linux and UTF-16 on Windows. A class rather than an alias of
+/// BasicWideString<wchar_t>, so it can still be forward declared.
+class WideString : public BasicWideString<wchar_t>
+{
+public:
+    using BasicWideString<wchar_t>::BasicWideString;
+
+    /// @brief Default constructor.
+    WideString() = default;
+
+    /// @brief Constructor from the base string, e.g. the result of an operation of BasicWideString.
+    /// @param str Wide string.
+    WideString(const BasicWideString<wchar_t>& str) : BasicWideString<wchar_t>(str) {}
+
+    /// @brief Constructor from the base string, e.g. the result of an operation of BasicWideString.
+    /// @param str Wide string.
+    WideString(BasicWideString<wchar_t>&& str) noexcept : BasicWideString<wchar_t>(std::move(str)) {}
 };
 
+static_assert(sizeof(WideString) == 32 && sizeof(Utf16String) == 32 && sizeof(Utf32String) == 32);
+
 /// ---------------------
 /// NarrowString implementation
 /// ---------------------
 
 inline NarrowString::NarrowString()
 {
-    mStr[0] = '\0';
 }
 
 inline NarrowString::NarrowString(const std::string& str)
 {
-    strcpy(mStr, str.c_str());
-
-    mSize = str.size();
+    mBuffer.Assign(str.data(), str.size());
 }
 
 inline NarrowString::NarrowString(const char* str)
 {
-    strcpy(mStr, str);
-
-    mSize = strlen(str);
+    mBuffer.Assign(str, strlen(str));
 }
 
 inline NarrowString::NarrowString(const std::wstring& str)
 {
-    wcstombs(mStr, str.c_str(), 32);
-
-    mSize = str.size();
+    mBuffer.AssignConverted(str.data(), str.size());
 }
 
 inline NarrowString::NarrowString(const wchar_t* str)
 {
-    wcstombs(mStr, str, 32);
-
-    mSize = wcslen(str);
+    mBuffer.AssignConverted(str, wcslen(str));
 }
 
-inline NarrowString::NarrowString(const WideString& str)
+template<typename C>
+NarrowString::NarrowString(const BasicWideString<C>& str)
 {
-    wcstombs(mStr, str.c_str(), 32);
-
-    mSize = str.size();
+    mBuffer.AssignConverted(str.data(), str.size());
 }
 
 inline NarrowString::~NarrowString()
 {
 }
 
-inline NarrowString::NarrowString(const NarrowString& other)
+inline NarrowString::NarrowString(const NarrowString& other) : mBuffer(other.mBuffer)
 {
-    strcpy(mStr, other.mStr);
-
-    mSize = other.mSize;
 }
 
-inline NarrowString::NarrowString(NarrowString&& other) noexcept
+inline NarrowString::NarrowString(NarrowString&& other) noexcept : mBuffer(std::move(other.mBuffer))
 {
-    strcpy(mStr, other.mStr);
-
-    mSize = other.mSize;
 }
 
 inline NarrowString& NarrowString::operator=(const NarrowString& other)
 {
-    strcpy(mStr, other.mStr);
-
-    mSize = other.mSize;
+    mBuffer = other.mBuffer;
 
     return *this;
 }
 
 inline NarrowString& NarrowString::operator=(NarrowString&& other) noexcept
 {
-    strcpy(mStr, other.mStr);
-
-    mSize = other.mSize;
+    mBuffer = std::move(other.mBuffer);
 
     return *this;
 }
 
 inline bool NarrowString::operator==(const NarrowString& other) const
 {
-    return strcmp(mStr, other.mStr) == 0;
+    return mBuffer == other.mBuffer;
 }
 
 inline const char& NarrowString::operator[](uint32_t index) const
 {
-    return mStr[index];
+    return mBuffer.Data()[index];
 }
 
 inline uint32_t NarrowString::size() const
 {
-    return mSize;
+    return mBuffer.Size();
 }
 
 inline const char* NarrowString::c_str() const
 {
-    return mStr;
+    return mBuffer.Data();
 }
 
 inline const char* NarrowString::data() const
 {
-    return mStr;
+    return mBuffer.Data();
+}
+
+inline uint32_t NarrowString::capacity() const
+{
+    return mBuffer.Capacity();
 }
 
 /// ---------------------
 /// WideString implementation
 /// ---------------------
 
-inline WideString::WideString()
+template<typename C>
+BasicWideString<C>::BasicWideString()
 {
-    mStr[0] = L'\0';
 }
 
-inline WideString::WideString(const std::string& str)
+template<typename C>
+BasicWideString<C>::BasicWideString(const std::string& str)
 {
-    mbstowcs(mStr, str.c_str(), 32);
-
-    mSize = str.size();
+    mBuffer.AssignConverted(str.data(), str.size());
 }
 
-inline WideString::WideString(const char* str)
+template<typename C>
+BasicWideString<C>::BasicWideString(const char* str)
 {
-    mbstowcs(mStr, str, 32);
-
-    mSize = strlen(str);
+    mBuffer.AssignConverted(str, strlen(str));
 }
 
-inline WideString::WideString(const std::wstring& str)
+template<typename C>
+BasicWideString<C>::BasicWideString(const std::wstring& str)
 {
-    wcscpy(mStr, str.c_str());
-
-    mSize = str.size();
+    mBuffer.AssignConverted(str.data(), str.size());
 }
 
-inline WideString::WideString(const wchar_t* str)
+template<typename C>
+BasicWideString<C>::BasicWideString(const wchar_t* str)
 {
-    wcscpy(mStr, str);
-
-    mSize = wcslen(str);
+    mBuffer.AssignConverted(str, wcslen(str));
 }
 
-inline WideString::WideString(const NarrowString& str)
+template<typename C>
+BasicWideString<C>::BasicWideString(const std::basic_string<C>& str)
+    requires(!std::is_same_v<C, wchar_t>)
 {
-    mbstowcs(mStr, str.c_str(), 32);
-
-    mSize = str.size();
+    mBuffer.Assign(str.data(), str.size());
 }
 
-inline WideString::~WideString()
+template<typename C>
+BasicWideString<C>::BasicWideString(const C* str)
+    requires(!std::is_same_v<C, wchar_t>)
 {
+    mBuffer.Assign(str, std::char_traits<C>::length(str));
 }
 
-inline WideString::WideString(const WideString& other)
+template<typename C>
+BasicWideString<C>::BasicWideString(const NarrowString& str)
 {
-    wcscpy(mStr, other.mStr);
+    mBuffer.AssignConverted(str.data(), str.size());
+}
 
-    mSize = other.mSize;
+template<typename C>
+template<typename D>
+    requires(!std::is_same_v<C, D>)
+BasicWideString<C>::BasicWideString(const BasicWideString<D>& str)
+{
+    mBuffer.AssignConverted(str.data(), str.size());
 }
 
-inline WideString::WideString(WideString&& other) noexcept
+template<typename C>
+BasicWideString<C>::~BasicWideString()
 {
-    wcscpy(mStr, other.mStr);
+}
 
-    mSize = other.mSize;
+template<typename C>
+BasicWideString<C>::BasicWideString(const BasicWideString& other) : mBuffer(other.mBuffer)
+{
 }
 
-inline WideString& WideString::operator=(const WideString& other)
+template<typename C>
+BasicWideString<C>::BasicWideString(BasicWideString&& other) noexcept : mBuffer(std::move(other.mBuffer))
 {
-    wcscpy(mStr, other.mStr);
+}
 
-    mSize = other.mSize;
+template<typename C>
+BasicWideString<C>& BasicWideString<C>::operator=(const BasicWideString& other)
+{
+    mBuffer = other.mBuffer;
 
     return *this;
 }
 
-inline WideString& WideString::operator=(WideString&& other) noexcept
+template<typename C>
+BasicWideString<C>& BasicWideString<C>::operator=(BasicWideString&& other) noexcept
 {
-    wcscpy(mStr, other.mStr);
-
-    mSize = other.mSize;
+    mBuffer = std::move(other.mBuffer);
 
     return *this;
 }
 
-inline bool WideString::operator==(const WideString& other) const
+template<typename C>
+bool BasicWideString<C>::operator==(const BasicWideString& other) const
 {
-    return wcscmp(mStr, other.mStr) == 0;
+    return mBuffer == other.mBuffer;
 }
 
-inline const wchar_t& WideString::operator[](uint32_t index) const
+template<typename C>
+const C& BasicWideString<C>::operator[](uint32_t index) const
 {
-    return mStr[index];
+    return mBuffer.Data()[index];
 }
 
-inline uint32_t WideString::size() const
+template<typename C>
+uint32_t BasicWideString<C>::size() const
 {
-    return mSize;
+    return mBuffer.Size();
 }
 
-inline const wchar_t* WideString::c_str() const
+template<typename C>
+const C* BasicWideString<C>::c_str() const
 {
-    return mStr;
+    return mBuffer.Data();
 }
 
-inline const wchar_t* WideString::data() const
+template<typename C>
+const C* BasicWideString<C>::data() const
 {
-    return mStr;
+    return mBuffer.Data();
+}
+
+template<typename C>
+uint32_t BasicWideString<C>::capacity() const
+{
+    return mBuffer.Capacity();
 }
 
 /// ---------------------
@@ -393,32 +674,59 @@ inline const wchar_t* WideString::data() const
 
 inline NarrowString::operator std::string()
 {
-    return std::string(mStr);
+    return std::string(data(), size());
 }
 
 inline NarrowString::operator std::wstring()
 {
-    std::wstring wStr = {};
-    wStr.resize(32);
+    std::wstring wStr(StringEncoding::LengthFromUtf8<wchar_t>(data(), size()), L'\0');
 
-    mbstowcs(wStr.data(), mStr, 32);
+    uint32_t count = StringEncoding::FromUtf8(data(), size(), wStr.data());
+
+    if (count == StringEncoding::Invalid)
+    {
+        count = StringEncoding::FromUtf8Replacing(data(), size(), static_cast<wchar_t*>(nullptr));
+        wStr.resize(count);
+        StringEncoding::FromUtf8Replacing(data(), size(), wStr.data());
+    }
+
+    wStr.resize(count);
 
     return wStr;
 }
 
-inline WideString::operator std::string()
+template<typename C>
+BasicWideString<C>::operator std::string()
 {
-    std::string str = {};
-    str.resize(32);
+    StringBuffer<char>::CheckSize(uint64_t(size()) * (StringEncoding::IsUtf16<C> ? 3 : 4));
+
+    std::string str(StringEncoding::Utf8Length(data(), size()), '\0');
+
+    uint32_t count = StringEncoding::ToUtf8(data(), size(), str.data());
+
+    if (count == StringEncoding::Invalid)
+    {
+        count = StringEncoding::ToUtf8Replacing(data(), size(), static_cast<char*>(nullptr));
+        str.resize(count);
+        StringEncoding::ToUtf8Replacing(data(), size(), str.data());
+    }
 
-    wcstombs(str.data(), mStr, 32);
+    str.resize(count);
 
     return str;
 }
 
-inline WideString::operator std::wstring()
+template<typename C>
+BasicWideString<C>::operator std::wstring()
 {
-    return std::wstring(mStr);
+    // A UTF-32 unit may become a surrogate pair.
+    constexpr uint64_t worstUnits = StringEncoding::IsUtf16<wchar_t> && !StringEncoding::IsUtf16<C> ? 2 : 1;
+    StringBuffer<wchar_t>::CheckSize(uint64_t(size()) * worstUnits);
+
+    std::wstring wStr(StringEncoding::Recode(data(), size(), static_cast<wchar_t*>(nullptr)), L'\0');
+    StringEncoding::Recode(data(), size(), wStr.data());
+
+    return wStr;
 }
 
 /// ---------------------
@@ -436,13 +744,18 @@ namespace std
         }
     };
 
-    template<>
-    struct hash<WideString>
+    template<typename C>
+    struct hash<BasicWideString<C>>
     {
-        size_t operator()(const WideString& str) const
+        size_t operator()(const BasicWideString<C>& str) const
         {
-            return hash<std::wstring_view>()(std::wstring_view(str.c_str(), str.size()));
+            return hash<std::basic_string_view<C>>()(std::basic_string_view<C>(str.c_str(), str.size()));
         }
     };
 
+    template<>
+    struct hash<WideString> : hash<BasicWideString<wchar_t>>
+    {
+    };
+
 } // namespace std
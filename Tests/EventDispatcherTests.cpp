@@ -0,0 +1,435 @@
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "EventDispatcher.h"
+#include "Test.h"
+
+namespace
+{
+    enum class TestEvent : uint16_t
+    {
+        A,
+        B,
+        C,
+    };
+
+    struct TestPayload
+    {
+        int32_t Target;
+
+        float Value;
+
+        uint64_t Id;
+    };
+
+    using Dispatcher = EventDispatcher<TestEvent, TestPayload>;
+
+    /// @brief Ids of the events the subscribers received, in order.
+    std::vector<uint64_t> gReceived;
+
+    void Receive(const TestPayload& data) { gReceived.push_back(data.Id); }
+
+    TestPayload Payload(uint64_t id, int32_t target = 0, float value = 0.0f) { return TestPayload{target, value, id}; }
+
+    /// --------------------------------------------------------
+    /// Coalescing
+    /// --------------------------------------------------------
+
+    void MergeIds(TestPayload& queued, const TestPayload& data) { queued.Id += data.Id; }
+
+    uint64_t TargetKey(const TestPayload& data) { return static_cast<uint64_t>(data.Target); }
+
+    void TestCoalescing()
+    {
+        gReceived.clear();
+
+        Dispatcher dispatcher;
+        dispatcher.Subscribe(TestEvent::A, &Receive);
+        dispatcher.Subscribe(TestEvent::B, &Receive);
+        dispatcher.Subscribe(TestEvent::C, &Receive);
+
+        dispatcher.SetCoalescePolicy(TestEvent::A, Dispatcher::CoalescePolicy::LatestWins);
+        dispatcher.SetMergeFunction(TestEvent::B, &MergeIds);
+        dispatcher.SetDeduplicationKey(TestEvent::C, &TargetKey);
+
+        dispatcher.QueueEvent(TestEvent::A, Payload(1));
+        dispatcher.QueueEvent(TestEvent::A, Payload(2));
+        dispatcher.QueueEvent(TestEvent::B, Payload(10));
+        dispatcher.QueueEvent(TestEvent::B, Payload(20));
+        dispatcher.QueueEvent(TestEvent::C, Payload(100, 1));
+        dispatcher.QueueEvent(TestEvent::C, Payload(200, 1));
+        dispatcher.QueueEvent(TestEvent::C, Payload(300, 2));
+        dispatcher.DispatchQueuedEvents();
+
+        CHECK((gReceived == std::vector<uint64_t>{2, 30, 100, 300}));
+        CHECK(dispatcher.GetCoalescedEventCount() == 3);
+
+        // Dispatched events aren't coalesced into anymore.
+        gReceived.clear();
+        dispatcher.QueueEvent(TestEvent::A, Payload(3));
+        dispatcher.QueueEvent(TestEvent::C, Payload(400, 1));
+        dispatcher.DispatchQueuedEvents();
+
+        CHECK((gReceived == std::vector<uint64_t>{3, 400}));
+    }
+
+    /// --------------------------------------------------------
+    /// Overflow policies
+    /// --------------------------------------------------------
+
+    std::vector<uint64_t> gOverflowed;
+
+    void Overflowed(TestEvent, const TestPayload& data) { gOverflowed.push_back(data.Id); }
+
+    std::vector<uint64_t> QueueWithCapacity(Dispatcher::OverflowPolicy policy, uint32_t count)
+    {
+        gReceived.clear();
+
+        Dispatcher dispatcher;
+        dispatcher.Subscribe(TestEvent::A, &Receive);
+        dispatcher.Subscribe(TestEvent::B, &Receive);
+        dispatcher.SetQueueCapacity(2, policy, &Overflowed);
+
+        // Event 2 is a B, with the Coalesce policy the later A events overwrite event 1.
+        for (uint32_t i = 1; i <= count; i++)
+        {
+            dispatcher.QueueEvent(i == 2 ? TestEvent::B : TestEvent::A, Payload(i));
+        }
+
+        dispatcher.DispatchQueuedEvents();
+        return gReceived;
+    }
+
+    using StringDispatcher = EventDispatcher<TestEvent, std::string>;
+
+    StringDispatcher* gStringDispatcher = nullptr;
+
+    std::vector<std::string> gReceivedStrings;
+
+    void ReceiveString(const std::string& data) { gReceivedStrings.push_back(data); }
+
+    void QueueFourStrings(const std::string&)
+    {
+        for (uint32_t i = 1; i <= 4; i++) { gStringDispatcher->QueueEvent(TestEvent::B, std::to_string(i)); }
+    }
+
+    void TestOverflowPolicies()
+    {
+        CHECK((QueueWithCapacity(Dispatcher::OverflowPolicy::DropNewest, 4) == std::vector<uint64_t>{1, 2}));
+        CHECK((QueueWithCapacity(Dispatcher::OverflowPolicy::DropOldest, 4) == std::vector<uint64_t>{3, 4}));
+        CHECK((QueueWithCapacity(Dispatcher::OverflowPolicy::Coalesce, 4) == std::vector<uint64_t>{4, 2}));
+
+        // Without double buffering there is no consumer to wait for, the new event is dropped.
+        gOverflowed.clear();
+        CHECK((QueueWithCapacity(Dispatcher::OverflowPolicy::Block, 3) == std::vector<uint64_t>{1, 2}));
+        CHECK((gOverflowed == std::vector<uint64_t>{3}));
+
+        gOverflowed.clear();
+        CHECK((QueueWithCapacity(Dispatcher::OverflowPolicy::Callback, 4) == std::vector<uint64_t>{1, 2}));
+        CHECK((gOverflowed == std::vector<uint64_t>{3, 4}));
+
+        // A per-type capacity only counts the events of its type.
+        gReceived.clear();
+
+        Dispatcher dispatcher;
+        dispatcher.Subscribe(TestEvent::A, &Receive);
+        dispatcher.Subscribe(TestEvent::B, &Receive);
+        dispatcher.SetQueueCapacity(TestEvent::A, 1, Dispatcher::OverflowPolicy::DropOldest);
+
+        dispatcher.QueueEvent(TestEvent::A, Payload(1));
+        dispatcher.QueueEvent(TestEvent::B, Payload(2));
+        dispatcher.QueueEvent(TestEvent::B, Payload(3));
+        dispatcher.QueueEvent(TestEvent::A, Payload(4));
+        dispatcher.DispatchQueuedEvents();
+
+        CHECK((gReceived == std::vector<uint64_t>{2, 3, 4}));
+        CHECK(dispatcher.GetDroppedEventCount() == 1);
+        CHECK(dispatcher.GetDroppedEventCount(TestEvent::A) == 1);
+        CHECK(dispatcher.GetDroppedEventCount(TestEvent::B) == 0);
+    }
+
+    Dispatcher* gBlockingDispatcher = nullptr;
+
+    void QueueOnConsumer(const TestPayload& data)
+    {
+        gBlockingDispatcher->QueueEvent(TestEvent::B, Payload(data.Id + 1));
+    }
+
+    void TestBlockOnConsumer()
+    {
+        gReceived.clear();
+        gOverflowed.clear();
+
+        Dispatcher dispatcher;
+        gBlockingDispatcher = &dispatcher;
+
+        dispatcher.EnableDoubleBuffering();
+        dispatcher.SetQueueCapacity(1, Dispatcher::OverflowPolicy::Block, &Overflowed);
+        dispatcher.Subscribe(TestEvent::A, &QueueOnConsumer);
+        dispatcher.Subscribe(TestEvent::B, &Receive);
+
+        // Event 1 is still counted while it's dispatched, waiting for room on the consumer thread would never end.
+        dispatcher.QueueEvent(TestEvent::A, Payload(1));
+        dispatcher.SwapEventQueues();
+        dispatcher.DispatchQueuedEvents();
+
+        CHECK((gOverflowed == std::vector<uint64_t>{2}));
+        CHECK(dispatcher.GetDroppedEventCount(TestEvent::B) == 1);
+
+        dispatcher.QueueEvent(TestEvent::B, Payload(3));
+        dispatcher.SwapEventQueues();
+        dispatcher.DispatchQueuedEvents();
+
+        CHECK((gReceived == std::vector<uint64_t>{3}));
+
+        gBlockingDispatcher = nullptr;
+    }
+
+    void TestDropOldestWhileDispatching()
+    {
+        gReceivedStrings.clear();
+
+        StringDispatcher dispatcher;
+        gStringDispatcher = &dispatcher;
+
+        // The subscriber fills the queue while event A is dispatched, the later subscriber still receives its data.
+        dispatcher.SetQueueCapacity(4, StringDispatcher::OverflowPolicy::DropOldest);
+        dispatcher.Subscribe(TestEvent::A, &QueueFourStrings, 1);
+        dispatcher.Subscribe(TestEvent::A, &ReceiveString);
+        dispatcher.Subscribe(TestEvent::B, &ReceiveString);
+
+        dispatcher.QueueEvent(TestEvent::A, "50");
+        dispatcher.DispatchQueuedEvents();
+
+        CHECK((gReceivedStrings == std::vector<std::string>{"50", "2", "3", "4"}));
+        CHECK(dispatcher.GetDroppedEventCount(TestEvent::B) == 1);
+
+        // The dropped event left the queue, its room is available again.
+        gReceivedStrings.clear();
+        dispatcher.QueueEvent(TestEvent::B, "5");
+        dispatcher.QueueEvent(TestEvent::B, "6");
+        dispatcher.DispatchQueuedEvents();
+
+        CHECK((gReceivedStrings == std::vector<std::string>{"5", "6"}));
+        CHECK(dispatcher.GetDroppedEventCount() == 1);
+
+        gStringDispatcher = nullptr;
+    }
+
+    /// --------------------------------------------------------
+    /// Concurrent subscriptions
+    /// --------------------------------------------------------
+
+    Dispatcher* gDispatcher = nullptr;
+
+    void ReceiveOther(const TestPayload& data) { gReceived.push_back(data.Id + 1000); }
+
+    /// @brief Unsubscribes ReceiveOther while the dispatch walks the list and reclaims the replaced snapshots.
+    void UnsubscribeOther(const TestPayload& data)
+    {
+        gReceived.push_back(data.Id);
+
+        gDispatcher->Unsubscribe(TestEvent::A, &ReceiveOther);
+        gDispatcher->ReclaimSubscriberSnapshots();
+    }
+
+    void TestSnapshotReclamation()
+    {
+        gReceived.clear();
+
+        Dispatcher dispatcher;
+        gDispatcher = &dispatcher;
+
+        dispatcher.EnableConcurrentSubscriptions();
+        dispatcher.Subscribe(TestEvent::A, &UnsubscribeOther, 1);
+        dispatcher.Subscribe(TestEvent::A, &ReceiveOther);
+
+        // The running dispatch keeps reading the snapshot it started with, reclaiming must not free it.
+        TestPayload data = Payload(1);
+        dispatcher.Dispatch(TestEvent::A, data);
+
+        CHECK((gReceived == std::vector<uint64_t>{1, 1001}));
+
+        gReceived.clear();
+        dispatcher.Dispatch(TestEvent::A, data);
+
+        CHECK((gReceived == std::vector<uint64_t>{1}));
+
+        // Channel subscriptions are published in the snapshots too.
+        gReceived.clear();
+        dispatcher.Subscribe(TestEvent::B, 42, &Receive);
+
+        TestPayload channelData = Payload(5);
+        dispatcher.Dispatch(TestEvent::B, 42, channelData);
+        dispatcher.Dispatch(TestEvent::B, 43, channelData);
+
+        CHECK((gReceived == std::vector<uint64_t>{5}));
+
+        dispatcher.ReclaimSubscriberSnapshots();
+        gDispatcher = nullptr;
+    }
+
+    /// --------------------------------------------------------
+    /// Lifetime tracking
+    /// --------------------------------------------------------
+
+    void TestPruning()
+    {
+        gReceived.clear();
+
+        Dispatcher dispatcher;
+        SharedPointer<int> owner = CreateSharedPointer<int>(0);
+
+        SubscriptionToken token = dispatcher.SubscribeScoped(TestEvent::A, &Receive);
+        CHECK(dispatcher.Subscribe(TestEvent::A, &ReceiveOther, owner));
+        CHECK(dispatcher.Subscribe(TestEvent::B, 7, &Receive, owner));
+        CHECK(token.IsActive());
+
+        TestPayload data = Payload(1);
+        dispatcher.Dispatch(TestEvent::A, data);
+        dispatcher.Dispatch(TestEvent::B, 7, data);
+
+        CHECK((gReceived == std::vector<uint64_t>{1, 1001, 1}));
+
+        gReceived.clear();
+        token.Reset();
+        dispatcher.Dispatch(TestEvent::A, data);
+
+        CHECK(!token.IsActive());
+        CHECK((gReceived == std::vector<uint64_t>{1001}));
+
+        gReceived.clear();
+        owner.reset();
+        dispatcher.QueueEvent(TestEvent::A, data);
+        dispatcher.DispatchQueuedEvents();
+        dispatcher.Dispatch(TestEvent::B, 7, data);
+        dispatcher.PruneSubscribers();
+        dispatcher.Dispatch(TestEvent::A, data);
+
+        CHECK(gReceived.empty());
+    }
+
+    void TestTrackingRejectedWhenConcurrent()
+    {
+        gReceived.clear();
+
+        Dispatcher dispatcher;
+        dispatcher.EnableConcurrentSubscriptions();
+
+        SharedPointer<int> owner = CreateSharedPointer<int>(0);
+        const SubscriptionToken token = dispatcher.SubscribeScoped(TestEvent::A, &Receive);
+
+        CHECK(!token.IsActive());
+        CHECK(!dispatcher.Subscribe(TestEvent::A, &Receive, owner));
+        CHECK(!dispatcher.Subscribe(TestEvent::A, 7, &Receive, owner));
+
+        TestPayload data = Payload(1);
+        dispatcher.Dispatch(TestEvent::A, data);
+        dispatcher.Dispatch(TestEvent::A, 7, data);
+
+        CHECK(gReceived.empty());
+    }
+
+    /// --------------------------------------------------------
+    /// Filters
+    /// --------------------------------------------------------
+
+    void TestFilters()
+    {
+        gReceived.clear();
+
+        Dispatcher dispatcher;
+        dispatcher.Subscribe(TestEvent::A, &Receive, Dispatcher::EventFilter::Equal(&TestPayload::Target, -3));
+        dispatcher.Subscribe(TestEvent::A, &ReceiveOther,
+                             Dispatcher::EventFilter::Range(&TestPayload::Value, 0.5f, 1.5f));
+
+        // More events than a filter batch, so the batch boundary is crossed.
+        std::vector<uint64_t> expected;
+
+        for (uint64_t i = 0; i < 150; i++)
+        {
+            const int32_t target = static_cast<int32_t>(i % 7) - 3;
+            const float value = static_cast<float>(i % 4) * 0.5f;
+
+            dispatcher.QueueEvent(TestEvent::A, Payload(i, target, value));
+
+            if (target == -3)
+            {
+                expected.push_back(i);
+            }
+
+            if (value >= 0.5f && value <= 1.5f)
+            {
+                expected.push_back(i + 1000);
+            }
+        }
+
+        dispatcher.DispatchQueuedEvents();
+        CHECK(gReceived == expected);
+
+        // Blocking dispatches check the filter on the spot.
+        gReceived.clear();
+
+        TestPayload matching = Payload(7, -3, 2.0f);
+        TestPayload other = Payload(8, 3, 1.0f);
+
+        dispatcher.Dispatch(TestEvent::A, matching);
+        dispatcher.Dispatch(TestEvent::A, other);
+
+        CHECK((gReceived == std::vector<uint64_t>{7, 1008}));
+    }
+
+    /// --------------------------------------------------------
+    /// Scheduled events
+    /// --------------------------------------------------------
+
+    void TestScheduledEvents()
+    {
+        gReceived.clear();
+
+        Dispatcher dispatcher;
+        dispatcher.Subscribe(TestEvent::A, &Receive);
+
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        dispatcher.QueueEventAt(TestEvent::A, Payload(2), now - std::chrono::milliseconds(1));
+        dispatcher.QueueEventAt(TestEvent::A, Payload(1), now - std::chrono::milliseconds(2));
+        dispatcher.QueueEventAfter(TestEvent::A, Payload(99), std::chrono::hours(1));
+        dispatcher.QueueEventAfterFrames(TestEvent::A, Payload(20), 2);
+        dispatcher.QueueEventAfterFrames(TestEvent::A, Payload(10), 1);
+        dispatcher.QueueEvent(TestEvent::A, Payload(0));
+
+        CHECK(dispatcher.GetScheduledEventCount() == 5);
+
+        // Due events come before the queued ones, frame events before clock events, each in the order they are due.
+        dispatcher.DispatchQueuedEvents();
+        CHECK((gReceived == std::vector<uint64_t>{10, 1, 2, 0}));
+
+        gReceived.clear();
+        dispatcher.DispatchQueuedEvents();
+        CHECK((gReceived == std::vector<uint64_t>{20}));
+
+        gReceived.clear();
+        dispatcher.DispatchQueuedEvents();
+        CHECK(gReceived.empty());
+        CHECK(dispatcher.GetScheduledEventCount() == 1);
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return Test::Run(argc, argv,
+                     {
+                         {"coalescing", &TestCoalescing},
+                         {"overflow_policies", &TestOverflowPolicies},
+                         {"drop_oldest_while_dispatching", &TestDropOldestWhileDispatching},
+                         {"block_on_consumer", &TestBlockOnConsumer},
+                         {"snapshot_reclamation", &TestSnapshotReclamation},
+                         {"pruning", &TestPruning},
+                         {"tracking_rejected_when_concurrent", &TestTrackingRejectedWhenConcurrent},
+                         {"filters", &TestFilters},
+                         {"scheduled_events", &TestScheduledEvents},
+                     });
+}
@@ -0,0 +1,252 @@
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "InternedString.h"
+#include "StringEncoding.h"
+#include "Strings.h"
+#include "Test.h"
+
+namespace
+{
+    /// --------------------------------------------------------
+    /// Small-string storage
+    /// --------------------------------------------------------
+
+    template<typename S, typename C>
+    void CheckInlineBoundary(C unit)
+    {
+        const std::basic_string<C> inlineUnits(S::InlineCapacity, unit);
+        const std::basic_string<C> heapUnits(S::InlineCapacity + 1, unit);
+
+        S inlineString(inlineUnits.c_str());
+        S heapString(heapUnits.c_str());
+
+        CHECK(inlineString.size() == S::InlineCapacity);
+        CHECK(inlineString.capacity() == S::InlineCapacity);
+        CHECK(inlineString.c_str()[S::InlineCapacity] == C(0));
+        CHECK(heapString.size() == S::InlineCapacity + 1);
+        CHECK(heapString.capacity() > S::InlineCapacity);
+        CHECK(heapString.c_str()[S::InlineCapacity + 1] == C(0));
+
+        // Inline units are copied by a move, heap units are handed over.
+        const C* heapUnitsAddress = heapString.data();
+        S movedHeap(std::move(heapString));
+        S movedInline(std::move(inlineString));
+
+        CHECK(movedHeap.data() == heapUnitsAddress);
+        CHECK(movedHeap == S(heapUnits.c_str()));
+        CHECK(movedInline == S(inlineUnits.c_str()));
+
+        // Copies of the heap string own their units, assigning a short string reuses the heap buffer.
+        S copy(movedHeap);
+        CHECK(copy.data() != movedHeap.data() && copy == movedHeap);
+
+        copy = movedInline;
+        CHECK(copy == movedInline && copy.capacity() > S::InlineCapacity);
+    }
+
+    void TestSmallStrings()
+    {
+        static_assert(NarrowString::InlineCapacity == 23);
+
+        CheckInlineBoundary<NarrowString>('x');
+        CheckInlineBoundary<Utf16String>(u'x');
+        CheckInlineBoundary<Utf32String>(U'x');
+
+        // A multibyte character that ends exactly at the boundary.
+        const NarrowString boundary((std::string(21, 'a') + "\xC3\xA9").c_str());
+
+        CHECK(boundary.size() == 23 && boundary.capacity() == 23);
+        CHECK(Utf16String(boundary).size() == 22);
+    }
+
+    /// --------------------------------------------------------
+    /// Transcoding
+    /// --------------------------------------------------------
+
+    /// @brief Bytes of ASCII in front of the invalid sequences, so they are also found after the vector paths.
+    const std::string AsciiPrefix(70, 'a');
+
+    /// @brief U+FFFD in UTF-8.
+    const std::string Replacement = "\xEF\xBF\xBD";
+
+    template<typename C>
+    uint32_t FromUtf8(const std::string& str)
+    {
+        std::vector<C> units(str.size() + 1);
+        return StringEncoding::FromUtf8(str.data(), static_cast<uint32_t>(str.size()), units.data());
+    }
+
+    template<typename C>
+    uint32_t ToUtf8(const std::basic_string<C>& str)
+    {
+        std::string bytes(str.size() * 4 + 1, '\0');
+        return StringEncoding::ToUtf8(str.data(), static_cast<uint32_t>(str.size()), bytes.data());
+    }
+
+    void TestInvalidUtf8()
+    {
+        const char* const invalid[] = {
+            "\x80",             // Continuation byte without a lead byte
+            "\xC0\xAF",         // Overlong two byte sequence
+            "\xE0\x80\xAF",     // Overlong three byte sequence
+            "\xF0\x80\x80\xAF", // Overlong four byte sequence
+            "\xED\xA0\x80",     // Encoded surrogate
+            "\xF4\x90\x80\x80", // Beyond U+10FFFF
+            "\xF5\x80\x80\x80", // Lead byte that can't occur
+            "\xE2\x82",         // Truncated at the end of the string
+            "\xE2\x28\xA1",     // Lead byte followed by ASCII
+        };
+
+        for (const char* sequence : invalid)
+        {
+            for (const std::string& str : {std::string(sequence), AsciiPrefix + sequence, sequence + AsciiPrefix})
+            {
+                CHECK(FromUtf8<char16_t>(str) == StringEncoding::Invalid);
+                CHECK(FromUtf8<char32_t>(str) == StringEncoding::Invalid);
+
+                // Strings replace the sequence instead, and the result is valid.
+                const Utf32String replaced(str);
+
+                CHECK(std::u32string_view(replaced.c_str()).find(U'\uFFFD') != std::u32string_view::npos);
+                CHECK(ToUtf8(std::u32string(replaced.c_str())) != StringEncoding::Invalid);
+            }
+        }
+
+        // The boundaries that are still valid.
+        CHECK(FromUtf8<char16_t>(AsciiPrefix + "\xC2\x80\xEF\xBF\xBF\xF4\x8F\xBF\xBF") == AsciiPrefix.size() + 4);
+        CHECK(FromUtf8<char32_t>(AsciiPrefix + "\xC2\x80\xEF\xBF\xBF\xF4\x8F\xBF\xBF") == AsciiPrefix.size() + 3);
+
+        // Every byte that doesn't start a valid sequence becomes U+FFFD, the conversions to STL strings as well.
+        NarrowString rejected(std::string("ok\xC0\xAF\xE2\x28\xA1"));
+
+        CHECK(Utf16String(rejected) == Utf16String(u"ok\uFFFD\uFFFD\uFFFD(\uFFFD"));
+        CHECK(std::wstring(rejected) == L"ok\uFFFD\uFFFD\uFFFD(\uFFFD");
+    }
+
+    void TestInvalidUtf16()
+    {
+        const std::u16string prefix(AsciiPrefix.begin(), AsciiPrefix.end());
+
+        // The invalid sequences with their UTF-8 after U+FFFD replaced the unpaired surrogates.
+        const std::pair<std::u16string, std::string> invalid[] = {
+            // High surrogate at the end
+            {std::u16string(1, char16_t(0xD800)), Replacement},
+            // Low surrogate without a high one
+            {std::u16string(1, char16_t(0xDC00)), Replacement},
+            // High surrogate followed by another unit
+            {std::u16string({char16_t(0xD800), u'a'}), Replacement + "a"},
+            // High surrogate followed by a pair
+            {std::u16string({char16_t(0xDBFF), char16_t(0xD800), char16_t(0xDC00)}), Replacement + "\xF0\x90\x80\x80"},
+        };
+
+        for (const auto& [sequence, replaced] : invalid)
+        {
+            CHECK(ToUtf8(sequence) == StringEncoding::Invalid);
+            CHECK(ToUtf8(prefix + sequence) == StringEncoding::Invalid);
+
+            Utf16String str(prefix + sequence);
+
+            CHECK(NarrowString(str) == NarrowString(AsciiPrefix + replaced));
+            CHECK(std::string(str) == AsciiPrefix + replaced);
+        }
+
+        CHECK(ToUtf8(prefix + u"\U0010FFFF") == prefix.size() + 4);
+
+        // Recoding replaces unpaired surrogates instead of failing.
+        const std::u16string unpaired({u'a', char16_t(0xDC00), char16_t(0xD800)});
+        const Utf32String recoded(Utf16String(unpaired.c_str()));
+
+        CHECK(recoded.size() == 3);
+        CHECK(recoded[0] == U'a' && recoded[1] == U'\uFFFD' && recoded[2] == U'\uFFFD');
+    }
+
+    void TestInvalidUtf32()
+    {
+        const std::u32string prefix(AsciiPrefix.begin(), AsciiPrefix.end());
+
+        for (const char32_t codePoint : {char32_t(0xD800), char32_t(0xDFFF), char32_t(0x110000), char32_t(0xFFFFFFFF)})
+        {
+            CHECK(ToUtf8(std::u32string(1, codePoint)) == StringEncoding::Invalid);
+            CHECK(ToUtf8(prefix + codePoint) == StringEncoding::Invalid);
+            CHECK(NarrowString(Utf32String(prefix + codePoint)) == NarrowString(AsciiPrefix + Replacement));
+        }
+
+        CHECK(ToUtf8(prefix + U'\U0010FFFF') == prefix.size() + 4);
+    }
+
+    void TestLengthLimit()
+    {
+        // The size and the terminator are counted in 32 bits, longer strings are rejected instead of truncated.
+        const auto rejects = [](uint64_t size) {
+            try
+            {
+                StringBuffer<char>::CheckSize(size);
+            }
+            catch (const std::length_error&)
+            {
+                return true;
+            }
+
+            return false;
+        };
+
+        CHECK(StringBuffer<char>::MaxSize == UINT32_MAX - 1);
+        CHECK(!rejects(StringBuffer<char>::MaxSize));
+        CHECK(rejects(uint64_t(StringBuffer<char>::MaxSize) + 1));
+        CHECK(rejects(uint64_t(UINT32_MAX) + 24));
+    }
+
+    /// --------------------------------------------------------
+    /// Interning
+    /// --------------------------------------------------------
+
+    void TestInternRehashing()
+    {
+        // Enough strings that every shard of the table rehashes several times.
+        constexpr uint32_t Count = 20000;
+
+        std::vector<std::string> strings;
+        std::vector<InternedString> interned;
+
+        for (uint32_t i = 0; i < Count; i++)
+        {
+            strings.push_back("intern-test-" + std::to_string(i));
+            interned.emplace_back(strings.back());
+        }
+
+        for (uint32_t i = 0; i < Count; i++)
+        {
+            InternedString found;
+
+            CHECK(InternedString::Find(strings[i], found) && found == interned[i]);
+            CHECK(InternedString(strings[i]) == interned[i]);
+            CHECK(std::string_view(interned[i]) == strings[i]);
+            CHECK(interned[i].Hash() == std::hash<NarrowString>()(NarrowString(strings[i])));
+        }
+
+        for (uint32_t i = 1; i < Count; i++) { CHECK(interned[i].Id() != interned[i - 1].Id()); }
+
+        InternedString missing;
+
+        CHECK(!InternedString::Find("intern-test-missing", missing));
+        CHECK(InternedString::Find("", missing) && missing == InternedString());
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    return Test::Run(argc, argv,
+                     {
+                         {"small_strings", &TestSmallStrings},
+                         {"length_limit", &TestLengthLimit},
+                         {"invalid_utf8", &TestInvalidUtf8},
+                         {"invalid_utf16", &TestInvalidUtf16},
+                         {"invalid_utf32", &TestInvalidUtf32},
+                         {"intern_rehashing", &TestInternRehashing},
+                     });
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+
+/// Harness shared by the test executables. A test is a function that checks its conditions with CHECK(), which
+/// unlike assert() is kept in release builds and doesn't stop the test, so one run reports every failed condition.
+/// The executables are registered with CTest and return a non-zero exit code if a check failed.
+
+namespace Test
+{
+    struct TestCase
+    {
+        const char* Name;
+
+        void (*Fn)();
+    };
+
+    /// @brief Number of failed checks of the running executable.
+    inline uint32_t& GetFailureCount()
+    {
+        static uint32_t failureCount = 0;
+        return failureCount;
+    }
+
+    inline void Fail(const char* file, int line, const char* condition)
+    {
+        std::cerr << file << ':' << line << ": CHECK(" << condition << ") failed\n";
+        GetFailureCount()++;
+    }
+
+    /// @brief Parses the command line of a test executable and runs its tests.
+    /// Usage: <executable> [--filter <substring>]
+    /// @param tests The tests of the executable.
+    /// @return The exit code of main().
+    inline int Run(int argc, char** argv, std::initializer_list<TestCase> tests)
+    {
+        const char* filter = "";
+
+        if (argc == 3 && std::strcmp(argv[1], "--filter") == 0)
+        {
+            filter = argv[2];
+        }
+        else if (argc != 1)
+        {
+            std::cerr << "Usage: " << argv[0] << " [--filter <substring>]\n";
+            return 1;
+        }
+
+        for (const TestCase& test : tests)
+        {
+            if (!std::strstr(test.Name, filter))
+            {
+                continue;
+            }
+
+            const uint32_t failureCount = GetFailureCount();
+            test.Fn();
+
+            std::cout << (GetFailureCount() == failureCount ? "[  OK  ] " : "[ FAIL ] ") << test.Name << '\n';
+        }
+
+        return GetFailureCount() == 0 ? 0 : 1;
+    }
+} // namespace Test
+
+/// @brief Checks a condition, a failure is reported with its location and the test goes on.
+#define CHECK(condition) ((condition) ? static_cast<void>(0) : Test::Fail(__FILE__, __LINE__, #condition))
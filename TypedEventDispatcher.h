@@ -0,0 +1,314 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "Function.h"
+
+/// @brief Declares the payload type of an event. Specialize it for every event dispatched through a
+/// TypedEventDispatcher:
+///     template<> struct EventPayload<WindowEvent::Resize> { using Type = ResizeData; };
+/// @tparam Event The event enum value.
+template<auto Event>
+struct EventPayload;
+
+/// @brief Payload type of an event.
+template<auto Event>
+using EventPayload_t = typename EventPayload<Event>::Type;
+
+/// @brief TypedEventDispatcher is an event dispatcher where every event has its own payload type, declared with
+/// EventPayload. Unlike EventDispatcher<E, T> the payload isn't a single type shared by all the events, so queued
+/// events only copy their own payload.
+/// Queued events are stored back to back in a linear arena (header followed by the payload), the arena is reset at
+/// the end of DispatchQueuedEvents(), so queueing an event doesn't allocate once the arena has grown to the size of
+/// a frame's worth of events.
+/// Subscribers are called in priority order like in EventDispatcher, and can stop the propagation of an event.
+/// @tparam E Enum type of the event. IT MUST BE AN ENUM CLASS.
+template<typename E>
+class TypedEventDispatcher
+{
+public:
+    /// @brief Enum type of the event.
+    using EventEnum_t = std::underlying_type_t<E>;
+
+    /// @brief Function pointer type to subscribe to an event.
+    template<E Event>
+    using EventFn = Function<void(const EventPayload_t<Event>&)>;
+
+    /// @brief Priority of a subscriber, subscribers with a higher priority are called first.
+    using Priority_t = int32_t;
+
+    /// @brief Default priority of a subscriber.
+    static constexpr Priority_t DefaultPriority = 0;
+
+    /// @brief Default size of an arena block, payloads larger than this get a block of their own.
+    static constexpr size_t DefaultBlockSize = 64 * 1024;
+
+    TypedEventDispatcher(size_t blockSize = DefaultBlockSize) : mBlockSize(blockSize) {}
+
+    TypedEventDispatcher(const TypedEventDispatcher&) = delete;
+
+    TypedEventDispatcher& operator=(const TypedEventDispatcher&) = delete;
+
+    ~TypedEventDispatcher() { ResetQueue(); }
+
+    /// @brief Subscribes to an event.
+    /// @tparam Event The event.
+    /// @param eventFn The function pointer to subscribe.
+    /// @param priority Priority of the subscriber, higher priorities are called first.
+    template<E Event>
+    void Subscribe(const EventFn<Event>& eventFn, Priority_t priority = DefaultPriority)
+    {
+        auto& subs = GetSubscribers<Event>().Subscribers;
+
+        const auto it = std::upper_bound(subs.begin(), subs.end(), priority,
+                                         [](Priority_t p, const auto& sub) { return p > sub.Priority; });
+
+        subs.insert(it, {eventFn, priority});
+    }
+
+    /// @brief Unsubscribes from an event. This is a linear search: O(n).
+    /// @tparam Event The event.
+    /// @param eventFn The function pointer to unsubscribe.
+    template<E Event>
+    void Unsubscribe(const EventFn<Event>& eventFn)
+    {
+        auto& subs = GetSubscribers<Event>().Subscribers;
+
+        const auto it = std::find_if(subs.begin(), subs.end(), [&](const auto& sub) { return sub.Fn == eventFn; });
+
+        if (it != subs.end())
+        {
+            subs.erase(it);
+        }
+    }
+
+    /// @brief Dispatches the event to all the subscribers of the event. This is a blocking call.
+    /// @tparam Event The event.
+    /// @param data The data to be passed to the subscribers.
+    template<E Event>
+    void Dispatch(const EventPayload_t<Event>& data)
+    {
+        const auto found = mEventSubscribers.find(static_cast<EventEnum_t>(Event));
+
+        if (found == mEventSubscribers.end())
+        {
+            return; // No subscribers for this event.
+        }
+
+        // The list was created by GetSubscribers<Event>(), so it holds subscribers of this payload type.
+        const auto& subs = static_cast<const SubscriberList<Event>&>(*found->second).Subscribers;
+
+        const bool outerStopped = mPropagationStopped;
+        mPropagationStopped = false;
+
+        for (const auto& sub : subs)
+        {
+            sub.Fn(data);
+
+            if (mPropagationStopped)
+            {
+                break; // The event was consumed.
+            }
+        }
+
+        mPropagationStopped = outerStopped;
+    }
+
+    /// @brief Consumes the event that is currently being dispatched. Only has an effect when called from inside a
+    /// subscriber.
+    void StopPropagation() { mPropagationStopped = true; }
+
+    /// @brief Queue an event to be dispatched later. The payload is constructed in place in the arena.
+    /// @tparam Event The event.
+    /// @param args Arguments to construct the payload from, usually the payload itself.
+    template<E Event, typename... Args>
+    void QueueEvent(Args&&... args)
+    {
+        using Payload = EventPayload_t<Event>;
+
+        static_assert(alignof(Payload) <= RecordAlignment, "Over-aligned payloads are not supported.");
+
+        constexpr size_t payloadOffset = AlignUp(sizeof(QueuedEventHeader), alignof(Payload));
+        constexpr size_t recordSize = AlignUp(payloadOffset + sizeof(Payload), RecordAlignment);
+
+        std::byte* record = Reserve(recordSize);
+
+        // Nothing is committed if the constructor throws, the arena is left as it was.
+        new (record + payloadOffset) Payload(std::forward<Args>(args)...);
+
+        QueuedEventHeader* header = new (record) QueuedEventHeader();
+        header->Dispatch = [](TypedEventDispatcher& dispatcher, void* payload) {
+            dispatcher.template Dispatch<Event>(*static_cast<const Payload*>(payload));
+        };
+
+        if constexpr (!std::is_trivially_destructible_v<Payload>)
+        {
+            header->Destroy = [](void* payload) { static_cast<Payload*>(payload)->~Payload(); };
+        }
+
+        header->PayloadOffset = static_cast<uint32_t>(payloadOffset);
+        header->Size = static_cast<uint32_t>(recordSize);
+
+        mBlocks[mCurrentBlock].Used += recordSize;
+    }
+
+    /// @brief Dispatches all the queued events in the order they were queued, including the events queued by the
+    /// subscribers while dispatching. Resets the arena afterwards.
+    void DispatchQueuedEvents()
+    {
+        // Blocks can be added and grow while dispatching, so always read the current block count and size.
+        for (size_t b = 0; b < mBlocks.size(); b++)
+        {
+            for (size_t offset = 0; offset < mBlocks[b].Used;)
+            {
+                std::byte* record = mBlocks[b].Data.get() + offset;
+                QueuedEventHeader* header = reinterpret_cast<QueuedEventHeader*>(record);
+
+                header->Dispatch(*this, record + header->PayloadOffset);
+
+                offset += header->Size;
+            }
+        }
+
+        ResetQueue();
+    }
+
+    /// @brief Destroys all the queued events without dispatching them. The arena memory is kept for the next frame.
+    void ResetQueue()
+    {
+        for (Block& block : mBlocks)
+        {
+            for (size_t offset = 0; offset < block.Used;)
+            {
+                std::byte* record = block.Data.get() + offset;
+                QueuedEventHeader* header = reinterpret_cast<QueuedEventHeader*>(record);
+
+                if (header->Destroy)
+                {
+                    header->Destroy(record + header->PayloadOffset);
+                }
+
+                offset += header->Size;
+            }
+
+            block.Used = 0;
+        }
+
+        mCurrentBlock = 0;
+    }
+
+    /// @brief Get the number of bytes reserved by the arena.
+    /// @return The total size of the arena blocks.
+    size_t GetArenaCapacity() const
+    {
+        size_t capacity = 0;
+        for (const Block& block : mBlocks) { capacity += block.Size; }
+        return capacity;
+    }
+
+private:
+    /// @brief Header written in front of every queued payload.
+    struct QueuedEventHeader
+    {
+        /// @brief Dispatches the payload, generated for the event the payload was queued for.
+        void (*Dispatch)(TypedEventDispatcher&, void*) = nullptr;
+
+        /// @brief Destroys the payload, null for trivially destructible payloads.
+        void (*Destroy)(void*) = nullptr;
+
+        /// @brief Offset of the payload from the start of the header.
+        uint32_t PayloadOffset = 0;
+
+        /// @brief Size of the header and the payload, the offset of the next record.
+        uint32_t Size = 0;
+    };
+
+    /// @brief Type erased base of the subscriber lists, so lists of different payload types can be stored in one map.
+    struct SubscriberListBase
+    {
+        virtual ~SubscriberListBase() = default;
+    };
+
+    template<E Event>
+    struct SubscriberList : SubscriberListBase
+    {
+        struct Subscriber
+        {
+            EventFn<Event> Fn;
+
+            Priority_t Priority = DefaultPriority;
+        };
+
+        std::vector<Subscriber> Subscribers;
+    };
+
+    /// @brief A block of the arena, records never straddle blocks.
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> Data;
+
+        size_t Size = 0;
+
+        size_t Used = 0;
+    };
+
+    /// @brief Every record starts at this alignment, so records can be walked by their size. Blocks are allocated
+    /// with new[], which aligns to it as well.
+    static constexpr size_t RecordAlignment = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+    static constexpr size_t AlignUp(size_t value, size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+    template<E Event>
+    SubscriberList<Event>& GetSubscribers()
+    {
+        auto& list = mEventSubscribers[static_cast<EventEnum_t>(Event)];
+
+        if (!list)
+        {
+            list = std::make_unique<SubscriberList<Event>>();
+        }
+
+        return static_cast<SubscriberList<Event>&>(*list);
+    }
+
+    /// @brief Finds room for a record in the arena, in the current block or the next one that fits it. The room is
+    /// only taken once the record is written, by adding its size to the used size of the current block.
+    std::byte* Reserve(size_t size)
+    {
+        // Blocks after the current one are empty, so this only skips blocks that are full.
+        for (; mCurrentBlock < mBlocks.size(); mCurrentBlock++)
+        {
+            Block& block = mBlocks[mCurrentBlock];
+
+            if (block.Used + size <= block.Size)
+            {
+                return block.Data.get() + block.Used;
+            }
+        }
+
+        Block& block = mBlocks.emplace_back();
+        block.Size = AlignUp(std::max(mBlockSize, size), RecordAlignment);
+        block.Data = std::make_unique<std::byte[]>(block.Size);
+
+        return block.Data.get();
+    }
+
+    std::unordered_map<EventEnum_t, std::unique_ptr<SubscriberListBase>> mEventSubscribers;
+
+    std::vector<Block> mBlocks;
+
+    /// @brief Index of the block new records are allocated from.
+    size_t mCurrentBlock = 0;
+
+    size_t mBlockSize;
+
+    bool mPropagationStopped = false;
+};